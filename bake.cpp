@@ -0,0 +1,318 @@
+#include "sdf.h"
+
+// ==============================================
+// field bake
+//
+// BuildFieldData produces the signed distance of every texel. The exact
+// backend runs the distance query per texel, O(texels * triangles). The
+// sweep backend is independent of the triangle count: the boundary
+// segments are rasterized into a seed image holding the nearest segment
+// per texel, the nearest segment is propagated with a two pass 8SSEDT
+// style sweep, and each texel then measures its distance to the segment
+// it ended up with. The propagation can hand a texel a segment that is not
+// its nearest, so the result approximates the boundary kernel;
+// sdfbake -checkerror measures by how much. The sign comes from scanline
+// filling the triangles.
+
+const char *bakebackendnames[NUM_BAKE_BACKENDS] = { "exact", "sweep" };
+int bakebackend = bb_exact;
+
+// the area of the world mapped onto the texture
+float bakemins[2] = { WORLD_MIN, WORLD_MIN };
+float bakemaxs[2] = { WORLD_MAX, WORLD_MAX };
+
+void Bake_TexelToWorld(int texw, int texh, float x, float y, float xy[2])
+{
+	xy[0] = bakemins[0] + (x / texw) * (bakemaxs[0] - bakemins[0]);
+	xy[1] = bakemins[1] + (y / texh) * (bakemaxs[1] - bakemins[1]);
+}
+
+static float Boundary_SegmentDistance2(const boundary_t *bd, int i, float p[2])
+{
+	float v[2], s;
+
+	v[0] = p[0] - bd->start[0][i];
+	v[1] = p[1] - bd->start[1][i];
+	s = ((v[0] * bd->edge[0][i]) + (v[1] * bd->edge[1][i])) * bd->invlen2[i];
+	s = min(max(s, 0.0f), 1.0f);
+	v[0] -= s * bd->edge[0][i];
+	v[1] -= s * bd->edge[1][i];
+
+	return (v[0] * v[0]) + (v[1] * v[1]);
+}
+
+// the exact bake split into square tiles for the thread pool. Every texel
+// goes through the same query as the serial path so the output is bit
+// identical whatever the thread count.
+
+typedef struct baketiles_s
+{
+	float *out;
+	int texw, texh;
+	int tilesx;
+
+} baketiles_t;
+
+static void Bake_ExactTile(int tile, int thread, void *data)
+{
+	baketiles_t *bt = (baketiles_t*)data;
+	float xy[BAKE_TILE_SIZE][2];
+	int x0, y0, x1, y1;
+
+	x0 = (tile % bt->tilesx) * BAKE_TILE_SIZE;
+	y0 = (tile / bt->tilesx) * BAKE_TILE_SIZE;
+	x1 = min(x0 + BAKE_TILE_SIZE, bt->texw);
+	y1 = min(y0 + BAKE_TILE_SIZE, bt->texh);
+
+	for (int y = y0; y < y1; y++)
+	{
+		for (int x = x0; x < x1; x++)
+			Bake_TexelToWorld(bt->texw, bt->texh, (float)x, (float)y, xy[x - x0]);
+
+		Distance_Batch(xy, bt->out + y * bt->texw + x0, x1 - x0);
+	}
+}
+
+static void Bake_ExactTiled(float *out, int texw, int texh)
+{
+	baketiles_t bt;
+	int tilesy;
+
+	bt.out = out;
+	bt.texw = texw;
+	bt.texh = texh;
+	bt.tilesx = (texw + BAKE_TILE_SIZE - 1) / BAKE_TILE_SIZE;
+	tilesy = (texh + BAKE_TILE_SIZE - 1) / BAKE_TILE_SIZE;
+
+	Threads_Run(bt.tilesx * tilesy, Bake_ExactTile, &bt);
+}
+
+static void Bake_ExactRows(float *out, int texw, int texh)
+{
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	float (*xy)[2] = (float(*)[2])Arena_Alloc(temp, texw * sizeof(*xy), MEM_ALIGN);
+
+	for (int y = 0; y < texh; y++)
+	{
+		// a whole row of texels goes through one batch query
+		for (int x = 0; x < texw; x++)
+			Bake_TexelToWorld(texw, texh, (float)x, (float)y, xy[x]);
+
+		Distance_Batch(xy, out + y * texw, texw);
+	}
+
+	Arena_Release(temp, mark);
+}
+
+// marks texels inside or on any triangle, every edge plane non positive.
+// Texels on an edge shared by two triangles are inside the union, so the
+// test is not strict.
+static void Bake_FillTriangles(unsigned char *inside, int texw, int texh)
+{
+	float scale[2] = { texw / (bakemaxs[0] - bakemins[0]), texh / (bakemaxs[1] - bakemins[1]) };
+
+	memset(inside, 0, texw * texh);
+	for (int tri = 0; tri < cooked.numtris; tri++)
+	{
+		float mins[2], maxs[2];
+		int y0, y1;
+
+		BVH_TriangleBounds(&cooked, tri, mins, maxs);
+		y0 = max(0, (int)ceilf((mins[1] - bakemins[1]) * scale[1]));
+		y1 = min(texh - 1, (int)floorf((maxs[1] - bakemins[1]) * scale[1]));
+
+		for (int y = y0; y <= y1; y++)
+		{
+			float p[2], xmin, xmax;
+			int x0, x1;
+
+			Bake_TexelToWorld(texw, texh, 0.0f, (float)y, p);
+			xmin = -1e30f;
+			xmax = 1e30f;
+
+			// clip the row against each edge plane a x + b y + c <= 0
+			for (int e = 0; e < 3; e++)
+			{
+				float a = cooked.plane[e][0][tri];
+				float rest = (cooked.plane[e][1][tri] * p[1]) + cooked.plane[e][2][tri];
+
+				if (a > 0.0f)
+					xmax = min(xmax, -rest / a);
+				else if (a < 0.0f)
+					xmin = max(xmin, -rest / a);
+				else if (rest > 0.0f)
+					xmax = -1e30f;
+			}
+			if (xmin > xmax)
+				continue;
+
+			x0 = max(0, (int)floorf((xmin - bakemins[0]) * scale[0]));
+			x1 = min(texw - 1, (int)ceilf((xmax - bakemins[0]) * scale[0]));
+			for (int x = x0; x <= x1; x++)
+			{
+				Bake_TexelToWorld(texw, texh, (float)x, (float)y, p);
+				if (CookedTriangleDistance(&cooked, tri, p) <= 0.0f)
+					inside[y * texw + x] = 1;
+			}
+		}
+	}
+}
+
+// takes the neighbour's segment if it is nearer to texel x y
+static inline void Bake_SweepTest(int *seg, float *dist2, int texw, int texh, int x, int y, int nx, int ny)
+{
+	int i = y * texw + x;
+	int n = ny * texw + nx;
+	float p[2], d2;
+
+	if (seg[n] < 0 || seg[n] == seg[i])
+		return;
+
+	Bake_TexelToWorld(texw, texh, (float)x, (float)y, p);
+	d2 = Boundary_SegmentDistance2(&boundary, seg[n], p);
+	if (d2 < dist2[i])
+	{
+		dist2[i] = d2;
+		seg[i] = seg[n];
+	}
+}
+
+void Bake_Sweep(float *out, int texw, int texh)
+{
+	int numtexels = texw * texh;
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	int *seg = (int*)Arena_Alloc(temp, numtexels * sizeof(int), MEM_ALIGN);
+	unsigned char *inside = (unsigned char*)Arena_Alloc(temp, numtexels, MEM_ALIGN);
+	float *dist2 = out;
+	float scale[2] = { texw / (bakemaxs[0] - bakemins[0]), texh / (bakemaxs[1] - bakemins[1]) };
+
+	for (int i = 0; i < numtexels; i++)
+	{
+		seg[i] = -1;
+		dist2[i] = 1e30f;
+	}
+
+	// seed the texels along each segment at half texel steps
+	for (int i = 0; i < boundary.numsegs; i++)
+	{
+		float len = max(fabsf(boundary.edge[0][i]) * scale[0], fabsf(boundary.edge[1][i]) * scale[1]);
+		int steps = (int)ceilf(len * 2.0f) + 1;
+
+		for (int s = 0; s <= steps; s++)
+		{
+			float f = (float)s / steps;
+			float p[2];
+			int x, y;
+
+			// segments off the image still seed the nearest edge texel
+			x = (int)floorf((boundary.start[0][i] + f * boundary.edge[0][i] - bakemins[0]) * scale[0] + 0.5f);
+			y = (int)floorf((boundary.start[1][i] + f * boundary.edge[1][i] - bakemins[1]) * scale[1] + 0.5f);
+			x = min(max(x, 0), texw - 1);
+			y = min(max(y, 0), texh - 1);
+
+			Bake_TexelToWorld(texw, texh, (float)x, (float)y, p);
+			float d2 = Boundary_SegmentDistance2(&boundary, i, p);
+			if (d2 < dist2[y * texw + x])
+			{
+				dist2[y * texw + x] = d2;
+				seg[y * texw + x] = i;
+			}
+		}
+	}
+
+	// forward pass, down the rows
+	for (int y = 0; y < texh; y++)
+	{
+		for (int x = 0; x < texw; x++)
+		{
+			if (x > 0)
+				Bake_SweepTest(seg, dist2, texw, texh, x, y, x - 1, y);
+			if (y > 0)
+			{
+				if (x > 0)
+					Bake_SweepTest(seg, dist2, texw, texh, x, y, x - 1, y - 1);
+				Bake_SweepTest(seg, dist2, texw, texh, x, y, x, y - 1);
+				if (x < texw - 1)
+					Bake_SweepTest(seg, dist2, texw, texh, x, y, x + 1, y - 1);
+			}
+		}
+		for (int x = texw - 2; x >= 0; x--)
+			Bake_SweepTest(seg, dist2, texw, texh, x, y, x + 1, y);
+	}
+
+	// backward pass, up the rows
+	for (int y = texh - 1; y >= 0; y--)
+	{
+		for (int x = texw - 1; x >= 0; x--)
+		{
+			if (x < texw - 1)
+				Bake_SweepTest(seg, dist2, texw, texh, x, y, x + 1, y);
+			if (y < texh - 1)
+			{
+				if (x < texw - 1)
+					Bake_SweepTest(seg, dist2, texw, texh, x, y, x + 1, y + 1);
+				Bake_SweepTest(seg, dist2, texw, texh, x, y, x, y + 1);
+				if (x > 0)
+					Bake_SweepTest(seg, dist2, texw, texh, x, y, x - 1, y + 1);
+			}
+		}
+		for (int x = 1; x < texw; x++)
+			Bake_SweepTest(seg, dist2, texw, texh, x, y, x - 1, y);
+	}
+
+	Bake_FillTriangles(inside, texw, texh);
+	for (int i = 0; i < numtexels; i++)
+	{
+		float d = sqrtf(dist2[i]);
+		out[i] = (inside[i] ? -d : d);
+	}
+
+	Arena_Release(temp, mark);
+}
+
+// the field is allocated from arena, scratch from the thread's temp arena
+float *BuildFieldData(arena_t *arena, int texw, int texh)
+{
+	TRACE_ZONE("BuildFieldData");
+	float *d = (float*)Arena_Alloc(arena, texw * texh * sizeof(float), COOKED_ALIGN);
+
+	// the sweep propagates along rows in order and stays serial
+	if (bakebackend == bb_sweep)
+		Bake_Sweep(d, texw, texh);
+	else if (pool.numthreads > 1)
+		Bake_ExactTiled(d, texw, texh);
+	else
+		Bake_ExactRows(d, texw, texh);
+
+	return d;
+}
+
+void ColorizeField(unsigned char *data, const float *d, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		float dd = max(-1.0f, min(d[i], 1.0f));
+		dd *= 50;
+
+		unsigned char *t = data + (i * 4);
+		*t++ = max(0, dd) + 50;
+		*t++ = 0;
+		*t++ = max(0, -dd) + 50;
+		*t++ = 255;
+	}
+}
+
+unsigned char *BuildTextureData(arena_t *arena, int texw, int texh)
+{
+	unsigned char *data = (unsigned char*)Arena_Alloc(arena, texw * texh * 4, MEM_ALIGN);
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	float *d = BuildFieldData(temp, texw, texh);
+
+	ColorizeField(data, d, texw * texh);
+	Arena_Release(temp, mark);
+
+	return data;
+}
@@ -0,0 +1,255 @@
+#include <sys/mman.h>
+
+#include "sdf.h"
+
+// ==============================================
+// memory allocation
+//
+// memory comes from arenas, stacks that are allocated from by bumping an
+// offset and freed by releasing back to an earlier mark. Mem_Alloc is the
+// permanent arena for everything that lives as long as the program: the
+// mesh, the acceleration structures and the baked fields. Scratch memory
+// comes from the calling thread's temp arena between a mark and a release,
+// and the frame arena holds data that only has to last until the next
+// tick. Nothing is handed back to the heap so a steady state frame makes
+// no heap allocations.
+//
+// each arena reserves a large range of address space up front with no
+// access and no backing. Pages are committed in MEM_COMMIT_SIZE steps as
+// the arena grows and handed back to the kernel when a release drops well
+// below them, so the resident size follows what is actually in use while
+// the reserve is too large to run out of in practice.
+
+#define MEM_PERMANENT_RESERVE	(64ull << 30)
+#define MEM_TEMP_RESERVE	(16ull << 30)
+#define MEM_FRAME_RESERVE	(4ull << 30)
+
+#define MEM_COMMIT_SIZE		(64 * 1024)
+#define MEM_HUGEPAGE_SIZE	(2 * 1024 * 1024)
+#define MEM_KEEP_SIZE		(1024 * 1024)		// committed slack kept above a release
+
+bool memhugepages;
+
+static arena_t permanentarena;
+static __thread arena_t temparena;
+static arena_t framearena;
+
+static size_t Mem_RoundUp(size_t size, size_t granularity)
+{
+	return (size + granularity - 1) & ~(granularity - 1);
+}
+
+// with hugepages the base is aligned and commits are whole huge pages so
+// transparent huge pages can back the arena
+void Arena_Reserve(arena_t *a, const char *name, size_t size, bool hugepages)
+{
+	size_t align = hugepages ? MEM_HUGEPAGE_SIZE : MEM_COMMIT_SIZE;
+	void *mapped = mmap(NULL, size + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (mapped == MAP_FAILED)
+		Error("Mem: unable to reserve %llu bytes for the %s arena\n", (unsigned long long)size, name);
+
+	a->name = name;
+	a->base = (unsigned char*)Mem_RoundUp((uintptr_t)mapped, align);
+	a->size = size;
+	a->commitsize = align;
+	a->committed = 0;
+	a->used = 0;
+	a->peak = 0;
+
+	if (hugepages && madvise(a->base, size, MADV_HUGEPAGE))
+		Warning("Mem: no transparent huge pages for the %s arena\n", name);
+}
+
+static void Arena_Commit(arena_t *a, size_t used)
+{
+	size_t committed = min(Mem_RoundUp(used, a->commitsize), a->size);
+
+	if (mprotect(a->base + a->committed, committed - a->committed, PROT_READ | PROT_WRITE))
+		Error("Mem: unable to commit %llu bytes in the %s arena\n", (unsigned long long)committed, a->name);
+
+	a->committed = committed;
+}
+
+static void Arena_Decommit(arena_t *a, size_t used)
+{
+	size_t keep = Mem_RoundUp(used + MEM_KEEP_SIZE, a->commitsize);
+
+	if (keep >= a->committed)
+		return;
+
+	// dropping the pages first means they read back as zero if recommitted
+	madvise(a->base + keep, a->committed - keep, MADV_DONTNEED);
+	mprotect(a->base + keep, a->committed - keep, PROT_NONE);
+	a->committed = keep;
+}
+
+// align must be a power of two
+void *Arena_Alloc(arena_t *a, size_t numbytes, int align)
+{
+	uintptr_t start, end;
+
+	start = ((uintptr_t)a->base + a->used + align - 1) & ~(uintptr_t)(align - 1);
+	end = start + numbytes;
+	if (end > (uintptr_t)a->base + a->size)
+		Error("Mem: %s arena out of space, %llu bytes wanted with %llu of %llu used\n", a->name,
+			(unsigned long long)numbytes, (unsigned long long)a->used, (unsigned long long)a->size);
+
+	a->used = end - (uintptr_t)a->base;
+	a->peak = max(a->peak, a->used);
+	if (a->used > a->committed)
+		Arena_Commit(a, a->used);
+
+	return (void*)start;
+}
+
+size_t Arena_Mark(const arena_t *a)
+{
+	return a->used;
+}
+
+// frees everything allocated since the mark
+void Arena_Release(arena_t *a, size_t mark)
+{
+	a->used = mark;
+	Arena_Decommit(a, mark);
+}
+
+void *Mem_Alloc(int numbytes, int tag)
+{
+	return Mem_AllocAligned(numbytes, MEM_ALIGN, tag);
+}
+
+void *Mem_AllocAligned(int numbytes, int align, int tag)
+{
+	if (!permanentarena.base)
+		Arena_Reserve(&permanentarena, "permanent", MEM_PERMANENT_RESERVE, memhugepages);
+
+	Mem_Track(tag, 0, numbytes);
+	return Arena_Alloc(&permanentarena, numbytes, align);
+}
+
+// the calling thread's scratch arena, created on first use
+arena_t *Mem_Temp()
+{
+	if (!temparena.base)
+		Arena_Reserve(&temparena, "temp", MEM_TEMP_RESERVE, memhugepages);
+
+	return &temparena;
+}
+
+// only for the main thread
+arena_t *Mem_Frame()
+{
+	if (!framearena.base)
+		Arena_Reserve(&framearena, "frame", MEM_FRAME_RESERVE, memhugepages);
+
+	return &framearena;
+}
+
+void Mem_ResetFrame()
+{
+	Arena_Release(Mem_Frame(), 0);
+}
+
+// ==============================================
+// memory accounting
+//
+// every Mem_Alloc is charged to a tag and to the total. The permanent arena never frees so
+// live only falls for memory that is not from an arena, which reports its
+// size changes through Mem_Track. The temp and frame arenas are reported
+// by their use and high water mark instead.
+
+const char *memtagnames[NUM_MEM_TAGS] = { "mesh", "mesh file", "cooked", "bvh", "grid", "boundary", "field", "adf" };
+
+static memtagstats_t memtags[NUM_MEM_TAGS];
+static memtagstats_t memtotal;
+
+// an allocation is counted when it grows from nothing
+void Mem_Track(int tag, size_t oldbytes, size_t newbytes)
+{
+	memtagstats_t *stats[2] = { memtags + tag, &memtotal };
+
+	for (int i = 0; i < 2; i++)
+	{
+		memtagstats_t *t = stats[i];
+
+		t->live = t->live - oldbytes + newbytes;
+		t->peak = max(t->peak, t->live);
+		if (!oldbytes && newbytes)
+			t->count++;
+	}
+}
+
+// NUM_MEM_TAGS for the total
+const memtagstats_t *Mem_TagStats(int tag)
+{
+	return tag == NUM_MEM_TAGS ? &memtotal : memtags + tag;
+}
+
+static void Mem_PrintArena(const arena_t *a)
+{
+	if (!a->base)
+		return;
+
+	printf("  %-10s %10.1f KB used %10.1f KB peak %10.1f KB committed\n", a->name,
+		a->used / 1024.0, a->peak / 1024.0, a->committed / 1024.0);
+}
+
+// the temp arena shown is the calling thread's
+void Mem_PrintStats()
+{
+	printf("memory tags:\n");
+	for (int i = 0; i <= NUM_MEM_TAGS; i++)
+	{
+		const memtagstats_t *t = Mem_TagStats(i);
+
+		printf("  %-10s %10.1f KB live %10.1f KB peak %8i allocs\n", i < NUM_MEM_TAGS ? memtagnames[i] : "total",
+			t->live / 1024.0, t->peak / 1024.0, t->count);
+	}
+
+	printf("arenas:\n");
+	Mem_PrintArena(&permanentarena);
+	Mem_PrintArena(&temparena);
+	Mem_PrintArena(&framearena);
+}
+
+// ==============================================
+// errors and warnings
+
+void Error(const char *error, ...)
+{
+	va_list valist;
+	char buffer[2048];
+
+	va_start(valist, error);
+	vsprintf(buffer, error, valist);
+	va_end(valist);
+
+	printf("Error: %s", buffer);
+	exit(1);
+}
+
+void Warning(const char *warning, ...)
+{
+	va_list valist;
+	char buffer[2048];
+
+	va_start(valist, warning);
+	vsprintf(buffer, warning, valist);
+	va_end(valist);
+
+	fprintf(stdout, "Warning: %s", buffer);
+}
+
+// ==============================================
+// timing
+
+// seconds from an arbitrary start
+double Sys_Time()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,1379 @@
+#include "sdf.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ==============================================
+// vector utils
+
+void Plane2d(float abc[3], float a[2], float b[2])
+{
+	float x0, y0, x1, y1, x, y, l, nx, ny, d;
+
+	x0 = a[0], y0 = a[1];
+	x1 = b[0], y1 = b[1];
+
+	x = x1 - x0;
+	y = y1 - y0;
+	l = sqrt((x * x) + (y * y));
+
+	nx =  y / l;
+	ny = -x / l;
+	d = -x0 * nx - y0 * ny;
+
+	abc[0] = nx, abc[1] = ny, abc[2] = d;
+}
+
+float PlaneDistance(float abc[3], float xy[2])
+{
+	float a, b, c, x, y;
+
+	a = abc[0], b = abc[1], c = abc[2];
+	x = xy[0], y = xy[1];
+	return (a * x) + (b * y) + c;
+}
+
+static float CircleDistance(float p[2], float r)
+{
+	return Vec2_Length(p) - r;
+}
+
+static float BoxDistance(float p[2])
+{
+	float d[2];
+	float b[2] = { 1, 0.2 };
+
+	d[0] = fabs(p[0]) - b[0];
+	d[1] = fabs(p[1]) - b[1];
+
+	float d2[2] = { max(d[0], 0.0f), max(d[1], 0.0f) };
+	return min(max(d[0], d[1]), 0.0f) + Vec2_Length(d2);
+}
+
+float TriangleDistance(float p[2], float v0[2], float v1[2], float v2[2])
+{
+	float abc0[3], abc1[3], abc2[3];
+	float n00[2], n01[2], n10[2], n11[2], n20[2], n21[2];
+
+	float v0p[2], v1p[2], v2p[2];
+
+	Plane2d(abc0, v0, v1);
+	Plane2d(abc1, v1, v2);
+	Plane2d(abc2, v2, v0);
+
+	// calculate positive and negative skewed normals
+	n00[0] = -abc2[1], n00[1] =  abc2[0];
+	n01[0] =  abc0[1], n01[1] = -abc0[0];
+	n10[0] = -abc0[1], n10[1] =  abc0[0];
+	n11[0] =  abc1[1], n11[1] = -abc1[0];
+	n20[0] = -abc1[1], n20[1] =  abc1[0];
+	n21[0] =  abc2[1], n21[1] = -abc2[0];
+
+	v0p[0] = p[0] - v0[0], v0p[1] = p[1] - v0[1];
+	v1p[0] = p[0] - v1[0], v1p[1] = p[1] - v1[1];
+	v2p[0] = p[0] - v2[0], v2p[1] = p[1] - v2[1];
+
+	if (Vec2_Dot(n00, v0p) > 0.0f && Vec2_Dot(n01, v0p) > 0.0f)
+		return Vec2_Length(v0p);
+	if (Vec2_Dot(n10, v1p) > 0.0f && Vec2_Dot(n11, v1p) > 0.0f)
+		return Vec2_Length(v1p);
+	if (Vec2_Dot(n20, v2p) > 0.0f && Vec2_Dot(n21, v2p) > 0.0f)
+		return Vec2_Length(v2p);
+
+	float f0 = PlaneDistance(abc0, p);
+	float f1 = PlaneDistance(abc1, p);
+	float f2 = PlaneDistance(abc2, p);
+
+	return max(f0, max(f1, f2));
+}
+
+
+// ==============================================
+// cooked triangles
+//
+// TriangleDistance redoes the edge planes and the skewed vertex region
+// normals on every call. The cooked table does that setup once at load time
+// and stores the results as aligned structure of arrays so a query only
+// reads precomputed values.
+
+cookedtris_t cooked;
+
+// triangles, or boundary segments, tested by the queries made on this
+// thread. Only differences are meaningful, the count wraps.
+__thread unsigned int distancetests;
+
+void Cook_Triangles(cookedtris_t *t, const mesh_t *m)
+{
+	t->numtris = m->numtris;
+	t->numpadded = (t->numtris + COOKED_WIDTH - 1) & ~(COOKED_WIDTH - 1);
+
+	int numbytes = t->numpadded * sizeof(float);
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			t->plane[i][j] = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_cooked);
+		for (int j = 0; j < 2; j++)
+		{
+			t->skew[i][j][0] = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_cooked);
+			t->skew[i][j][1] = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_cooked);
+			t->vert[i][j] = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_cooked);
+		}
+	}
+
+	// the padding is filled with copies of the first triangle so it never
+	// changes the result of a min over the table
+	for (int i = 0; i < t->numpadded; i++)
+	{
+		float *v[3], abc[3][3];
+		int tri = (i < t->numtris ? i : 0);
+
+		v[0] = m->verts[m->tris[tri][0]];
+		v[1] = m->verts[m->tris[tri][1]];
+		v[2] = m->verts[m->tris[tri][2]];
+
+		for (int e = 0; e < 3; e++)
+		{
+			Plane2d(abc[e], v[e], v[(e + 1) % 3]);
+			t->plane[e][0][i] = abc[e][0];
+			t->plane[e][1][i] = abc[e][1];
+			t->plane[e][2][i] = abc[e][2];
+		}
+
+		// vertex n is bounded by the negative skew of the incoming edge
+		// and the positive skew of the outgoing edge
+		for (int n = 0; n < 3; n++)
+		{
+			float *in = abc[(n + 2) % 3];
+			float *out = abc[n];
+
+			t->skew[n][0][0][i] = -in[1];
+			t->skew[n][0][1][i] =  in[0];
+			t->skew[n][1][0][i] =  out[1];
+			t->skew[n][1][1][i] = -out[0];
+			t->vert[n][0][i] = v[n][0];
+			t->vert[n][1][i] = v[n][1];
+		}
+	}
+}
+
+// same as TriangleDistance but reading from the cooked table
+float CookedTriangleDistance(const cookedtris_t *t, int i, float p[2])
+{
+	for (int n = 0; n < 3; n++)
+	{
+		float vp[2];
+
+		vp[0] = p[0] - t->vert[n][0][i];
+		vp[1] = p[1] - t->vert[n][1][i];
+		if ((t->skew[n][0][0][i] * vp[0]) + (t->skew[n][0][1][i] * vp[1]) > 0.0f &&
+			(t->skew[n][1][0][i] * vp[0]) + (t->skew[n][1][1][i] * vp[1]) > 0.0f)
+			return Vec2_Length(vp);
+	}
+
+	float f0 = (t->plane[0][0][i] * p[0]) + (t->plane[0][1][i] * p[1]) + t->plane[0][2][i];
+	float f1 = (t->plane[1][0][i] * p[0]) + (t->plane[1][1][i] * p[1]) + t->plane[1][2][i];
+	float f2 = (t->plane[2][0][i] * p[0]) + (t->plane[2][1][i] * p[1]) + t->plane[2][2][i];
+
+	return max(f0, max(f1, f2));
+}
+
+// CookedTriangleDistance that also returns the gradient of the nearest
+// feature, the direction from a vertex or an edge normal
+float CookedTriangleGradient(const cookedtris_t *t, int i, float p[2], float grad[2])
+{
+	for (int n = 0; n < 3; n++)
+	{
+		float vp[2], len;
+
+		vp[0] = p[0] - t->vert[n][0][i];
+		vp[1] = p[1] - t->vert[n][1][i];
+		if ((t->skew[n][0][0][i] * vp[0]) + (t->skew[n][0][1][i] * vp[1]) > 0.0f &&
+			(t->skew[n][1][0][i] * vp[0]) + (t->skew[n][1][1][i] * vp[1]) > 0.0f)
+		{
+			len = Vec2_Length(vp);
+			grad[0] = vp[0] / len;
+			grad[1] = vp[1] / len;
+			return len;
+		}
+	}
+
+	float f[3];
+	int e;
+
+	f[0] = (t->plane[0][0][i] * p[0]) + (t->plane[0][1][i] * p[1]) + t->plane[0][2][i];
+	f[1] = (t->plane[1][0][i] * p[0]) + (t->plane[1][1][i] * p[1]) + t->plane[1][2][i];
+	f[2] = (t->plane[2][0][i] * p[0]) + (t->plane[2][1][i] * p[1]) + t->plane[2][2][i];
+
+	// same selection as max(f0, max(f1, f2))
+	e = (f[1] > f[2] ? 1 : 2);
+	e = (f[0] > f[e] ? 0 : e);
+	grad[0] = t->plane[e][0][i];
+	grad[1] = t->plane[e][1][i];
+
+	return f[e];
+}
+
+// ==============================================
+// simd triangle distance
+//
+// evaluates SIMD_WIDTH cooked triangles per iteration. All three vertex
+// regions and the edge region are computed for every lane and the result is
+// picked with masks rather than branches. The lanes use the same operations
+// in the same order as CookedTriangleDistance so the results are bit
+// identical (the Makefile disables fp contraction for this reason).
+
+#if defined(__AVX__)
+
+#define SIMD_WIDTH	8
+
+typedef __m256 vfloat_t;
+
+#define VF_Load(p)		_mm256_load_ps(p)
+#define VF_Store(p, a)		_mm256_store_ps(p, a)
+#define VF_Set1(x)		_mm256_set1_ps(x)
+#define VF_Add(a, b)		_mm256_add_ps(a, b)
+#define VF_Sub(a, b)		_mm256_sub_ps(a, b)
+#define VF_Mul(a, b)		_mm256_mul_ps(a, b)
+#define VF_Min(a, b)		_mm256_min_ps(a, b)
+#define VF_Max(a, b)		_mm256_max_ps(a, b)
+#define VF_Sqrt(a)		_mm256_sqrt_ps(a)
+#define VF_And(a, b)		_mm256_and_ps(a, b)
+#define VF_CmpGt(a, b)		_mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define VF_Select(m, a, b)	_mm256_blendv_ps(b, a, m)
+#define VF_Xor(a, b)		_mm256_xor_ps(a, b)
+#define VF_CmpLt(a, b)		_mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define VF_MoveMask(a)		_mm256_movemask_ps(a)
+
+#elif defined(__SSE2__)
+
+#define SIMD_WIDTH	4
+
+typedef __m128 vfloat_t;
+
+#define VF_Load(p)		_mm_load_ps(p)
+#define VF_Store(p, a)		_mm_store_ps(p, a)
+#define VF_Set1(x)		_mm_set1_ps(x)
+#define VF_Add(a, b)		_mm_add_ps(a, b)
+#define VF_Sub(a, b)		_mm_sub_ps(a, b)
+#define VF_Mul(a, b)		_mm_mul_ps(a, b)
+#define VF_Min(a, b)		_mm_min_ps(a, b)
+#define VF_Max(a, b)		_mm_max_ps(a, b)
+#define VF_Sqrt(a)		_mm_sqrt_ps(a)
+#define VF_And(a, b)		_mm_and_ps(a, b)
+#define VF_CmpGt(a, b)		_mm_cmpgt_ps(a, b)
+#define VF_Select(m, a, b)	_mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+#define VF_Xor(a, b)		_mm_xor_ps(a, b)
+#define VF_CmpLt(a, b)		_mm_cmplt_ps(a, b)
+#define VF_MoveMask(a)		_mm_movemask_ps(a)
+
+#endif
+
+// batch query blocking, DISTANCE_BLOCK_TRIS must be a multiple of COOKED_WIDTH
+#define DISTANCE_BLOCK_POINTS	64
+#define DISTANCE_BLOCK_TRIS	128
+
+#ifdef SIMD_WIDTH
+
+// returns the per lane distances for triangles [i, i + SIMD_WIDTH)
+static inline vfloat_t TriangleDistanceSIMD(const cookedtris_t *t, int i, vfloat_t px, vfloat_t py)
+{
+	vfloat_t zero = VF_Set1(0.0f);
+	vfloat_t f0, f1, f2, d;
+
+	// edge region
+	f0 = VF_Add(VF_Add(VF_Mul(VF_Load(t->plane[0][0] + i), px), VF_Mul(VF_Load(t->plane[0][1] + i), py)), VF_Load(t->plane[0][2] + i));
+	f1 = VF_Add(VF_Add(VF_Mul(VF_Load(t->plane[1][0] + i), px), VF_Mul(VF_Load(t->plane[1][1] + i), py)), VF_Load(t->plane[1][2] + i));
+	f2 = VF_Add(VF_Add(VF_Mul(VF_Load(t->plane[2][0] + i), px), VF_Mul(VF_Load(t->plane[2][1] + i), py)), VF_Load(t->plane[2][2] + i));
+	d = VF_Max(f0, VF_Max(f1, f2));
+
+	// vertex regions, applied in reverse so vertex 0 wins like the scalar
+	// early outs
+	for (int n = 2; n >= 0; n--)
+	{
+		vfloat_t vpx, vpy, s0, s1, mask, len;
+
+		vpx = VF_Sub(px, VF_Load(t->vert[n][0] + i));
+		vpy = VF_Sub(py, VF_Load(t->vert[n][1] + i));
+		s0 = VF_Add(VF_Mul(VF_Load(t->skew[n][0][0] + i), vpx), VF_Mul(VF_Load(t->skew[n][0][1] + i), vpy));
+		s1 = VF_Add(VF_Mul(VF_Load(t->skew[n][1][0] + i), vpx), VF_Mul(VF_Load(t->skew[n][1][1] + i), vpy));
+		mask = VF_And(VF_CmpGt(s0, zero), VF_CmpGt(s1, zero));
+		len = VF_Sqrt(VF_Add(VF_Mul(vpx, vpx), VF_Mul(vpy, vpy)));
+		d = VF_Select(mask, len, d);
+	}
+
+	return d;
+}
+
+static float VF_HorizontalMin(vfloat_t a)
+{
+	float lanes[SIMD_WIDTH] __attribute__((aligned(COOKED_ALIGN)));
+	float d;
+
+	VF_Store(lanes, a);
+	d = lanes[0];
+	for (int i = 1; i < SIMD_WIDTH; i++)
+		d = min(d, lanes[i]);
+
+	return d;
+}
+
+float Brute_Distance(float p[2])
+{
+	vfloat_t px, py, d;
+
+	px = VF_Set1(p[0]);
+	py = VF_Set1(p[1]);
+	distancetests += cooked.numtris;
+
+	// the table is padded with copies of triangle 0 so whole vectors can be
+	// read without a tail loop
+	d = TriangleDistanceSIMD(&cooked, 0, px, py);
+	for (int i = SIMD_WIDTH; i < cooked.numpadded; i += SIMD_WIDTH)
+		d = VF_Min(d, TriangleDistanceSIMD(&cooked, i, px, py));
+
+	return VF_HorizontalMin(d);
+}
+
+// Brute_Distance that also returns the index of the nearest triangle. Each
+// lane keeps the index of its best triangle, ties go to the lowest index.
+float Brute_Nearest(float p[2], int *nearest)
+{
+	float lanes[SIMD_WIDTH] __attribute__((aligned(COOKED_ALIGN)));
+	float index[SIMD_WIDTH] __attribute__((aligned(COOKED_ALIGN)));
+	vfloat_t px, py, d, idx, bestidx, step;
+	int best;
+
+	for (int i = 0; i < SIMD_WIDTH; i++)
+		index[i] = (float)i;
+
+	px = VF_Set1(p[0]);
+	py = VF_Set1(p[1]);
+	idx = VF_Load(index);
+	step = VF_Set1((float)SIMD_WIDTH);
+	distancetests += cooked.numtris;
+
+	d = TriangleDistanceSIMD(&cooked, 0, px, py);
+	bestidx = idx;
+	for (int i = SIMD_WIDTH; i < cooked.numpadded; i += SIMD_WIDTH)
+	{
+		vfloat_t q, mask;
+
+		idx = VF_Add(idx, step);
+		q = TriangleDistanceSIMD(&cooked, i, px, py);
+		mask = VF_CmpLt(q, d);
+		d = VF_Select(mask, q, d);
+		bestidx = VF_Select(mask, idx, bestidx);
+	}
+
+	VF_Store(lanes, d);
+	VF_Store(index, bestidx);
+	best = 0;
+	for (int i = 1; i < SIMD_WIDTH; i++)
+	{
+		if (lanes[i] < lanes[best] || (lanes[i] == lanes[best] && index[i] < index[best]))
+			best = i;
+	}
+
+	// padding lanes are copies of triangle 0
+	*nearest = (int)index[best];
+	if (*nearest >= cooked.numtris)
+		*nearest = 0;
+
+	return lanes[best];
+}
+
+// Brute_Distance for many points at once. The queries are processed in blocks of
+// DISTANCE_BLOCK_POINTS against blocks of DISTANCE_BLOCK_TRIS cooked
+// triangles so the triangle block (27 floats per triangle) stays in L1
+// while every point in the block is tested against it.
+void Brute_DistanceBatch(float (*p)[2], float *d, int numpoints)
+{
+	vfloat_t acc[DISTANCE_BLOCK_POINTS];
+
+	distancetests += (unsigned int)numpoints * cooked.numtris;
+	for (int first = 0; first < numpoints; first += DISTANCE_BLOCK_POINTS)
+	{
+		int count = min(DISTANCE_BLOCK_POINTS, numpoints - first);
+
+		for (int tri = 0; tri < cooked.numpadded; tri += DISTANCE_BLOCK_TRIS)
+		{
+			int lasttri = min(tri + DISTANCE_BLOCK_TRIS, cooked.numpadded);
+
+			for (int j = 0; j < count; j++)
+			{
+				vfloat_t px, py, dd;
+				int i = tri;
+
+				px = VF_Set1(p[first + j][0]);
+				py = VF_Set1(p[first + j][1]);
+
+				if (tri == 0)
+				{
+					dd = TriangleDistanceSIMD(&cooked, 0, px, py);
+					i += SIMD_WIDTH;
+				}
+				else
+					dd = acc[j];
+
+				for (; i < lasttri; i += SIMD_WIDTH)
+					dd = VF_Min(dd, TriangleDistanceSIMD(&cooked, i, px, py));
+
+				acc[j] = dd;
+			}
+		}
+
+		for (int j = 0; j < count; j++)
+			d[first + j] = VF_HorizontalMin(acc[j]);
+	}
+}
+
+#else
+
+float Brute_Distance(float p[2])
+{
+	float d;
+
+	distancetests += cooked.numtris;
+	d = CookedTriangleDistance(&cooked, 0, p);
+	for (int i = 1; i < cooked.numtris; i++)
+	{
+		float q = CookedTriangleDistance(&cooked, i, p);
+		d = min(d, q);
+	}
+
+	return d;
+}
+
+float Brute_Nearest(float p[2], int *nearest)
+{
+	float d;
+
+	distancetests += cooked.numtris;
+	d = CookedTriangleDistance(&cooked, 0, p);
+	*nearest = 0;
+	for (int i = 1; i < cooked.numtris; i++)
+	{
+		float q = CookedTriangleDistance(&cooked, i, p);
+		if (q < d)
+		{
+			d = q;
+			*nearest = i;
+		}
+	}
+
+	return d;
+}
+
+void Brute_DistanceBatch(float (*p)[2], float *d, int numpoints)
+{
+	for (int i = 0; i < numpoints; i++)
+		d[i] = Brute_Distance(p[i]);
+}
+
+#endif
+
+// ==============================================
+// bounding volume hierarchy
+//
+// an AABB tree over the cooked triangles. The nearest query is branch and
+// bound: a subtree is skipped when the signed distance to its box is no
+// smaller than the best triangle distance found so far. The signed box
+// distance is a lower bound on the signed distance of anything inside the
+// box, and the leaves evaluate the same kernel as the brute force path, so
+// the result is identical to Brute_Distance.
+
+#define BVH_LEAF_TRIS	4
+#define BVH_MAX_DEPTH	64
+
+// node boxes are grown by this fraction of the mesh extent so float
+// rounding in the edge planes can never put a triangle below its box bound
+#define BVH_EPSILON	1e-5f
+
+bvh_t bvh;
+
+// build state
+static float (*bvhcentroids)[2];
+static int bvhsortaxis;
+
+static int BVH_CompareCentroids(const void *a, const void *b)
+{
+	float ca = bvhcentroids[*(const int*)a][bvhsortaxis];
+	float cb = bvhcentroids[*(const int*)b][bvhsortaxis];
+
+	return (ca < cb ? -1 : (ca > cb ? 1 : 0));
+}
+
+void BVH_TriangleBounds(const cookedtris_t *t, int tri, float mins[2], float maxs[2])
+{
+	for (int k = 0; k < 2; k++)
+	{
+		mins[k] = min(t->vert[0][k][tri], min(t->vert[1][k][tri], t->vert[2][k][tri]));
+		maxs[k] = max(t->vert[0][k][tri], max(t->vert[1][k][tri], t->vert[2][k][tri]));
+	}
+}
+
+static void BVH_BuildNode(bvh_t *b, const cookedtris_t *t, int nodenum, int first, int count, float epsilon, int depth)
+{
+	bvhnode_t *node = b->nodes + nodenum;
+	float cmins[2], cmaxs[2];
+
+	node->mins[0] = node->mins[1] = 1e30f;
+	node->maxs[0] = node->maxs[1] = -1e30f;
+	cmins[0] = cmins[1] = 1e30f;
+	cmaxs[0] = cmaxs[1] = -1e30f;
+
+	for (int i = first; i < first + count; i++)
+	{
+		float mins[2], maxs[2];
+		int tri = b->tris[i];
+
+		BVH_TriangleBounds(t, tri, mins, maxs);
+		for (int k = 0; k < 2; k++)
+		{
+			node->mins[k] = min(node->mins[k], mins[k] - epsilon);
+			node->maxs[k] = max(node->maxs[k], maxs[k] + epsilon);
+			cmins[k] = min(cmins[k], bvhcentroids[tri][k]);
+			cmaxs[k] = max(cmaxs[k], bvhcentroids[tri][k]);
+		}
+	}
+
+	if (count <= BVH_LEAF_TRIS || depth == BVH_MAX_DEPTH - 2)
+	{
+		node->first = first;
+		node->count = count;
+		return;
+	}
+
+	// median split along the longest centroid axis
+	bvhsortaxis = (cmaxs[0] - cmins[0] >= cmaxs[1] - cmins[1] ? 0 : 1);
+	qsort(b->tris + first, count, sizeof(int), BVH_CompareCentroids);
+
+	node->first = b->numnodes;
+	node->count = 0;
+	b->numnodes += 2;
+
+	int half = count / 2;
+	BVH_BuildNode(b, t, node->first + 0, first, half, epsilon, depth + 1);
+	BVH_BuildNode(b, t, node->first + 1, first + half, count - half, epsilon, depth + 1);
+}
+
+void BVH_Build(bvh_t *b, const cookedtris_t *t)
+{
+	float extent = 0.0f;
+
+	b->numtris = t->numtris;
+	b->tris = (int*)Mem_Alloc(t->numtris * sizeof(int), mt_bvh);
+	b->nodes = (bvhnode_t*)Mem_AllocAligned(2 * t->numtris * sizeof(bvhnode_t), COOKED_ALIGN, mt_bvh);
+	b->numnodes = 1;
+
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	bvhcentroids = (float(*)[2])Arena_Alloc(temp, t->numtris * sizeof(*bvhcentroids), MEM_ALIGN);
+	for (int i = 0; i < t->numtris; i++)
+	{
+		b->tris[i] = i;
+		for (int k = 0; k < 2; k++)
+		{
+			bvhcentroids[i][k] = (t->vert[0][k][i] + t->vert[1][k][i] + t->vert[2][k][i]) / 3.0f;
+			extent = max(extent, fabsf(t->vert[0][k][i]));
+			extent = max(extent, fabsf(t->vert[1][k][i]));
+			extent = max(extent, fabsf(t->vert[2][k][i]));
+		}
+	}
+
+	BVH_BuildNode(b, t, 0, 0, t->numtris, BVH_EPSILON * max(1.0f, extent), 0);
+
+	Arena_Release(temp, mark);
+	bvhcentroids = NULL;
+}
+
+// signed distance to an axis aligned box, negative inside
+static float BVH_BoxDistance(const bvhnode_t *node, float p[2])
+{
+	float d[2];
+
+	d[0] = max(node->mins[0] - p[0], p[0] - node->maxs[0]);
+	d[1] = max(node->mins[1] - p[1], p[1] - node->maxs[1]);
+
+	float d2[2] = { max(d[0], 0.0f), max(d[1], 0.0f) };
+	return min(max(d[0], d[1]), 0.0f) + Vec2_Length(d2);
+}
+
+float BVH_Nearest(const bvh_t *b, const cookedtris_t *t, float p[2], int *nearest)
+{
+	int stack[BVH_MAX_DEPTH];
+	int sp;
+	float best = 1e30f;
+
+	*nearest = 0;
+
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp)
+	{
+		const bvhnode_t *node = b->nodes + stack[--sp];
+
+		if (BVH_BoxDistance(node, p) >= best)
+			continue;
+
+		if (node->count)
+		{
+			distancetests += node->count;
+			for (int i = node->first; i < node->first + node->count; i++)
+			{
+				float q = CookedTriangleDistance(t, b->tris[i], p);
+				if (q < best)
+				{
+					best = q;
+					*nearest = b->tris[i];
+				}
+			}
+			continue;
+		}
+
+		// push the far child first so the near one is searched first and
+		// tightens the bound sooner
+		const bvhnode_t *c = b->nodes + node->first;
+		float d0 = BVH_BoxDistance(c + 0, p);
+		float d1 = BVH_BoxDistance(c + 1, p);
+
+		if (d0 < d1)
+		{
+			if (d1 < best)
+				stack[sp++] = node->first + 1;
+			stack[sp++] = node->first + 0;
+		}
+		else
+		{
+			if (d0 < best)
+				stack[sp++] = node->first + 0;
+			stack[sp++] = node->first + 1;
+		}
+	}
+
+	return best;
+}
+
+float BVH_Distance(const bvh_t *b, const cookedtris_t *t, float p[2])
+{
+	int nearest;
+
+	return BVH_Nearest(b, t, p, &nearest);
+}
+
+// true when p is inside or on any triangle, stopping at the first one
+bool BVH_Inside(const bvh_t *b, const cookedtris_t *t, float p[2])
+{
+	int stack[BVH_MAX_DEPTH];
+	int sp;
+
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp)
+	{
+		const bvhnode_t *node = b->nodes + stack[--sp];
+
+		if (p[0] < node->mins[0] || p[0] > node->maxs[0] || p[1] < node->mins[1] || p[1] > node->maxs[1])
+			continue;
+
+		if (node->count)
+		{
+			distancetests += node->count;
+			for (int i = node->first; i < node->first + node->count; i++)
+			{
+				if (CookedTriangleDistance(t, b->tris[i], p) <= 0.0f)
+					return true;
+			}
+			continue;
+		}
+
+		stack[sp++] = node->first + 0;
+		stack[sp++] = node->first + 1;
+	}
+
+	return false;
+}
+
+// calls func for every triangle whose distance from p is at most maxdist
+void BVH_Collect(const bvh_t *b, const cookedtris_t *t, float p[2], float maxdist, void (*func)(int tri, void *data), void *data)
+{
+	int stack[BVH_MAX_DEPTH];
+	int sp;
+
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp)
+	{
+		const bvhnode_t *node = b->nodes + stack[--sp];
+
+		if (BVH_BoxDistance(node, p) > maxdist)
+			continue;
+
+		if (node->count)
+		{
+			for (int i = node->first; i < node->first + node->count; i++)
+			{
+				if (CookedTriangleDistance(t, b->tris[i], p) <= maxdist)
+					func(b->tris[i], data);
+			}
+			continue;
+		}
+
+		stack[sp++] = node->first + 0;
+		stack[sp++] = node->first + 1;
+	}
+}
+
+// ==============================================
+// uniform grid
+//
+// a grid of square cells over the mesh bounds where each cell lists every
+// triangle that could be nearest to some point in the cell. The distance
+// field is 1-lipschitz so with r the cell half diagonal and c the cell
+// center, the nearest triangle to any point in the cell is within
+// Distance(c) + 2r of c. That set is gathered with the BVH at build time
+// and a query only scans its own cell. Points outside the grid fall back
+// to the BVH.
+
+// slack on the candidate radius to cover float rounding
+#define GRID_EPSILON		1e-4f
+
+grid_t grid;
+
+static void Grid_CountTri(int tri, void *data)
+{
+	(*(int*)data)++;
+}
+
+static void Grid_AddTri(int tri, void *data)
+{
+	int **out = (int**)data;
+
+	*(*out)++ = tri;
+}
+
+static void Grid_CellCenter(const grid_t *g, int x, int y, float c[2])
+{
+	c[0] = g->mins[0] + (x + 0.5f) * g->cellsize;
+	c[1] = g->mins[1] + (y + 0.5f) * g->cellsize;
+}
+
+// res is the number of cells along the longest axis of the mesh bounds
+void Grid_Build(grid_t *g, const bvh_t *b, const cookedtris_t *t, int res)
+{
+	const bvhnode_t *root = b->nodes;
+	float size[2], radius;
+	int numcells, total;
+
+	size[0] = root->maxs[0] - root->mins[0];
+	size[1] = root->maxs[1] - root->mins[1];
+	g->buildres = res;
+	g->cellsize = max(size[0], size[1]) / res;
+	g->invcellsize = 1.0f / g->cellsize;
+	g->mins[0] = root->mins[0];
+	g->mins[1] = root->mins[1];
+	g->res[0] = max(1, (int)ceilf(size[0] * g->invcellsize));
+	g->res[1] = max(1, (int)ceilf(size[1] * g->invcellsize));
+
+	numcells = g->res[0] * g->res[1];
+	radius = 0.70710678f * g->cellsize;
+	g->cellstart = (int*)Mem_Alloc((numcells + 1) * sizeof(int), mt_grid);
+
+	// count the candidates, then fill them
+	total = 0;
+	for (int y = 0; y < g->res[1]; y++)
+	{
+		for (int x = 0; x < g->res[0]; x++)
+		{
+			float c[2];
+			int count = 0;
+
+			Grid_CellCenter(g, x, y, c);
+			BVH_Collect(b, t, c, BVH_Distance(b, t, c) + 2 * radius + GRID_EPSILON, Grid_CountTri, &count);
+
+			g->cellstart[y * g->res[0] + x] = total;
+			total += count;
+		}
+	}
+	g->cellstart[numcells] = total;
+
+	g->tris = (int*)Mem_Alloc(total * sizeof(int), mt_grid);
+	for (int y = 0; y < g->res[1]; y++)
+	{
+		for (int x = 0; x < g->res[0]; x++)
+		{
+			float c[2];
+			int *out = g->tris + g->cellstart[y * g->res[0] + x];
+
+			Grid_CellCenter(g, x, y, c);
+			BVH_Collect(b, t, c, BVH_Distance(b, t, c) + 2 * radius + GRID_EPSILON, Grid_AddTri, &out);
+		}
+	}
+
+	printf("grid %i x %i cells, %i candidates, %.1f per cell\n", g->res[0], g->res[1], total, (float)total / numcells);
+}
+
+float Grid_Nearest(const grid_t *g, float p[2], int *nearest)
+{
+	int x, y, cell;
+	float d;
+
+	x = (int)floorf((p[0] - g->mins[0]) * g->invcellsize);
+	y = (int)floorf((p[1] - g->mins[1]) * g->invcellsize);
+	if (x < 0 || y < 0 || x >= g->res[0] || y >= g->res[1])
+		return BVH_Nearest(&bvh, &cooked, p, nearest);
+
+	cell = y * g->res[0] + x;
+	d = 1e30f;
+	*nearest = 0;
+	distancetests += g->cellstart[cell + 1] - g->cellstart[cell];
+	for (int i = g->cellstart[cell]; i < g->cellstart[cell + 1]; i++)
+	{
+		float q = CookedTriangleDistance(&cooked, g->tris[i], p);
+		if (q < d)
+		{
+			d = q;
+			*nearest = g->tris[i];
+		}
+	}
+
+	return d;
+}
+
+float Grid_Distance(const grid_t *g, float p[2])
+{
+	int nearest;
+
+	return Grid_Nearest(g, p, &nearest);
+}
+
+// ==============================================
+// boundary edges
+//
+// most triangle edges are shared with a neighbour and can never be the
+// nearest boundary. The boundary of the triangle union is extracted once,
+// after which a query is the unsigned distance to the boundary segments
+// with the sign taken from an inside test against the triangles in the
+// bvh. Unlike the min over triangles this is also correct inside
+// overlapping triangles. The sign does not come from a crossing test
+// against the segments: the split points where pieces meet are computed
+// separately for each edge and do not match exactly, so a ray through a
+// junction can miscount and flip the sign of a whole scanline.
+//
+// Every triangle edge is split wherever another triangle's edge crosses it
+// or another triangle's vertex lies on it. A piece is kept when a probe
+// just outside its midpoint is not inside any triangle.
+
+// probe offset as a fraction of the mesh extent
+#define BOUNDARY_EPSILON	1e-5f
+
+boundary_t boundary;
+
+// build state
+typedef struct boundarybuild_s
+{
+	const cookedtris_t *t;
+	int self;
+	float a[2], b[2];
+	float len;
+	float normal[2];
+	float mid[2];
+	float probe[2];
+	float epsilon;
+
+	int numsplits, maxsplits;
+	float *splits;
+
+	bool inside;
+
+} boundarybuild_t;
+
+static void Boundary_AddSplit(boundarybuild_t *bb, float s)
+{
+	// splits within epsilon of an end would only make slivers
+	if (s * bb->len <= bb->epsilon || (1.0f - s) * bb->len <= bb->epsilon)
+		return;
+
+	if (bb->numsplits == bb->maxsplits)
+	{
+		bb->maxsplits = max(16, bb->maxsplits * 2);
+		bb->splits = (float*)realloc(bb->splits, bb->maxsplits * sizeof(float));
+	}
+	bb->splits[bb->numsplits++] = s;
+}
+
+// adds split points where the edges and vertices of tri touch the edge a b
+static void Boundary_SplitAgainst(int tri, void *data)
+{
+	boundarybuild_t *bb = (boundarybuild_t*)data;
+	const cookedtris_t *t = bb->t;
+	float e[2], len2;
+
+	if (tri == bb->self)
+		return;
+
+	e[0] = bb->b[0] - bb->a[0];
+	e[1] = bb->b[1] - bb->a[1];
+	len2 = (e[0] * e[0]) + (e[1] * e[1]);
+
+	for (int n = 0; n < 3; n++)
+	{
+		float c[2], f[2], cross, s, u;
+		float line;
+
+		c[0] = t->vert[n][0][tri];
+		c[1] = t->vert[n][1][tri];
+
+		// vertex on the edge
+		line = (e[0] * (c[1] - bb->a[1]) - e[1] * (c[0] - bb->a[0])) / sqrtf(len2);
+		if (fabsf(line) < bb->epsilon)
+			Boundary_AddSplit(bb, ((c[0] - bb->a[0]) * e[0] + (c[1] - bb->a[1]) * e[1]) / len2);
+
+		// proper crossing with the edge c d
+		f[0] = t->vert[(n + 1) % 3][0][tri] - c[0];
+		f[1] = t->vert[(n + 1) % 3][1][tri] - c[1];
+		cross = (e[0] * f[1]) - (e[1] * f[0]);
+		if (cross == 0.0f)
+			continue;
+
+		s = ((c[0] - bb->a[0]) * f[1] - (c[1] - bb->a[1]) * f[0]) / cross;
+		u = ((c[0] - bb->a[0]) * e[1] - (c[1] - bb->a[1]) * e[0]) / cross;
+		if (u > 0.0f && u < 1.0f)
+			Boundary_AddSplit(bb, s);
+	}
+}
+
+// a piece is interior when the probe is inside another triangle. Pieces
+// that coincide with an edge of a lower numbered triangle facing the same
+// way are dropped too so coincident edges are only emitted once.
+static void Boundary_TestInside(int tri, void *data)
+{
+	boundarybuild_t *bb = (boundarybuild_t*)data;
+	const cookedtris_t *t = bb->t;
+
+	if (CookedTriangleDistance(t, tri, bb->probe) < 0.0f)
+	{
+		bb->inside = true;
+		return;
+	}
+
+	if (tri >= bb->self)
+		return;
+
+	for (int n = 0; n < 3; n++)
+	{
+		float *abc[3] = { t->plane[n][0], t->plane[n][1], t->plane[n][2] };
+		float side, e[2], s;
+
+		if ((abc[0][tri] * bb->normal[0]) + (abc[1][tri] * bb->normal[1]) < 0.99f)
+			continue;
+
+		side = (abc[0][tri] * bb->mid[0]) + (abc[1][tri] * bb->mid[1]) + abc[2][tri];
+		if (fabsf(side) > bb->epsilon)
+			continue;
+
+		e[0] = t->vert[(n + 1) % 3][0][tri] - t->vert[n][0][tri];
+		e[1] = t->vert[(n + 1) % 3][1][tri] - t->vert[n][1][tri];
+		s = ((bb->mid[0] - t->vert[n][0][tri]) * e[0]) + ((bb->mid[1] - t->vert[n][1][tri]) * e[1]);
+		if (s > 0.0f && s < (e[0] * e[0]) + (e[1] * e[1]))
+			bb->inside = true;
+	}
+}
+
+static int Boundary_CompareSplits(const void *a, const void *b)
+{
+	float sa = *(const float*)a;
+	float sb = *(const float*)b;
+
+	return (sa < sb ? -1 : (sa > sb ? 1 : 0));
+}
+
+void Boundary_Build(boundary_t *bd, const bvh_t *b, const cookedtris_t *t)
+{
+	boundarybuild_t bb;
+	float (*segs)[4];
+	int numsegs, maxsegs;
+	float extent;
+
+	extent = max(b->nodes[0].maxs[0] - b->nodes[0].mins[0], b->nodes[0].maxs[1] - b->nodes[0].mins[1]);
+
+	memset(&bb, 0, sizeof(bb));
+	bb.t = t;
+	bb.epsilon = BOUNDARY_EPSILON * max(1.0f, extent);
+
+	numsegs = 0;
+	maxsegs = 64;
+	segs = (float(*)[4])malloc(maxsegs * sizeof(*segs));
+
+	for (int tri = 0; tri < t->numtris; tri++)
+	{
+		for (int n = 0; n < 3; n++)
+		{
+			float mid[2], e[2];
+
+			bb.self = tri;
+			bb.a[0] = t->vert[n][0][tri];
+			bb.a[1] = t->vert[n][1][tri];
+			bb.b[0] = t->vert[(n + 1) % 3][0][tri];
+			bb.b[1] = t->vert[(n + 1) % 3][1][tri];
+
+			e[0] = bb.b[0] - bb.a[0];
+			e[1] = bb.b[1] - bb.a[1];
+			bb.len = Vec2_Length(e);
+			if (bb.len == 0.0f)
+				continue;
+
+			// outward normal is the edge plane normal
+			bb.normal[0] = t->plane[n][0][tri];
+			bb.normal[1] = t->plane[n][1][tri];
+
+			// anything touching the edge is within half its length of the midpoint
+			mid[0] = bb.a[0] + 0.5f * e[0];
+			mid[1] = bb.a[1] + 0.5f * e[1];
+			bb.numsplits = 0;
+			BVH_Collect(b, t, mid, 0.5f * bb.len + bb.epsilon, Boundary_SplitAgainst, &bb);
+
+			qsort(bb.splits, bb.numsplits, sizeof(float), Boundary_CompareSplits);
+
+			float s0 = 0.0f;
+			for (int i = 0; i <= bb.numsplits; i++)
+			{
+				float s1 = (i < bb.numsplits ? bb.splits[i] : 1.0f);
+				float sm;
+
+				if (s1 <= s0)
+					continue;
+
+				// probe just outside the midpoint of the piece
+				sm = 0.5f * (s0 + s1);
+				bb.mid[0] = bb.a[0] + sm * e[0];
+				bb.mid[1] = bb.a[1] + sm * e[1];
+				bb.probe[0] = bb.mid[0] + bb.epsilon * bb.normal[0];
+				bb.probe[1] = bb.mid[1] + bb.epsilon * bb.normal[1];
+				bb.inside = false;
+				BVH_Collect(b, t, bb.probe, 2 * bb.epsilon, Boundary_TestInside, &bb);
+
+				if (!bb.inside)
+				{
+					if (numsegs == maxsegs)
+					{
+						maxsegs *= 2;
+						segs = (float(*)[4])realloc(segs, maxsegs * sizeof(*segs));
+					}
+					segs[numsegs][0] = bb.a[0] + s0 * e[0];
+					segs[numsegs][1] = bb.a[1] + s0 * e[1];
+					segs[numsegs][2] = bb.a[0] + s1 * e[0];
+					segs[numsegs][3] = bb.a[1] + s1 * e[1];
+					numsegs++;
+				}
+
+				s0 = s1;
+			}
+		}
+	}
+
+	free(bb.splits);
+
+	bd->numsegs = numsegs;
+	bd->numpadded = (numsegs + COOKED_WIDTH - 1) & ~(COOKED_WIDTH - 1);
+
+	int numbytes = max(bd->numpadded, COOKED_WIDTH) * sizeof(float);
+	for (int k = 0; k < 2; k++)
+	{
+		bd->start[k] = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_boundary);
+		bd->edge[k] = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_boundary);
+	}
+	bd->invlen2 = (float*)Mem_AllocAligned(numbytes, COOKED_ALIGN, mt_boundary);
+
+	// the padding is zero length segments on the first start point, they
+	// are never nearer than the first segment
+	for (int i = 0; i < max(bd->numpadded, COOKED_WIDTH); i++)
+	{
+		float *s = segs[(i < numsegs ? i : 0)];
+		float ex = (i < numsegs ? s[2] - s[0] : 0.0f);
+		float ey = (i < numsegs ? s[3] - s[1] : 0.0f);
+
+		bd->start[0][i] = (numsegs ? s[0] : 1e30f);
+		bd->start[1][i] = (numsegs ? s[1] : 1e30f);
+		bd->edge[0][i] = ex;
+		bd->edge[1][i] = ey;
+		bd->invlen2[i] = (ex != 0.0f || ey != 0.0f ? 1.0f / ((ex * ex) + (ey * ey)) : 0.0f);
+	}
+
+	free(segs);
+
+	printf("boundary %i segments from %i triangle edges\n", numsegs, t->numtris * 3);
+}
+
+#ifdef SIMD_WIDTH
+
+// when nearest is set the index of the nearest segment is tracked as well
+float Boundary_Nearest(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2], int *nearest)
+{
+	float lanes[SIMD_WIDTH] __attribute__((aligned(COOKED_ALIGN)));
+	float index[SIMD_WIDTH] __attribute__((aligned(COOKED_ALIGN)));
+	vfloat_t px, py, zero, one, best, idx, bestidx, step;
+
+	for (int i = 0; i < SIMD_WIDTH; i++)
+		index[i] = (float)i;
+
+	px = VF_Set1(p[0]);
+	py = VF_Set1(p[1]);
+	zero = VF_Set1(0.0f);
+	one = VF_Set1(1.0f);
+	best = VF_Set1(1e30f);
+	idx = bestidx = VF_Load(index);
+	step = VF_Set1((float)SIMD_WIDTH);
+	distancetests += bd->numsegs;
+
+	for (int i = 0; i < bd->numpadded; i += SIMD_WIDTH, idx = VF_Add(idx, step))
+	{
+		vfloat_t ax, ay, ex, ey, vx, vy, s, qx, qy, d2;
+
+		ax = VF_Load(bd->start[0] + i);
+		ay = VF_Load(bd->start[1] + i);
+		ex = VF_Load(bd->edge[0] + i);
+		ey = VF_Load(bd->edge[1] + i);
+
+		// squared distance to the nearest point on the segment
+		vx = VF_Sub(px, ax);
+		vy = VF_Sub(py, ay);
+		s = VF_Mul(VF_Add(VF_Mul(vx, ex), VF_Mul(vy, ey)), VF_Load(bd->invlen2 + i));
+		s = VF_Min(VF_Max(s, zero), one);
+		qx = VF_Sub(vx, VF_Mul(s, ex));
+		qy = VF_Sub(vy, VF_Mul(s, ey));
+		d2 = VF_Add(VF_Mul(qx, qx), VF_Mul(qy, qy));
+		if (nearest)
+			bestidx = VF_Select(VF_CmpLt(d2, best), idx, bestidx);
+		best = VF_Min(best, d2);
+	}
+
+	float d;
+
+	if (nearest)
+	{
+		int lane = 0;
+
+		VF_Store(lanes, best);
+		VF_Store(index, bestidx);
+		for (int i = 1; i < SIMD_WIDTH; i++)
+		{
+			if (lanes[i] < lanes[lane])
+				lane = i;
+		}
+		*nearest = min((int)index[lane], max(bd->numsegs - 1, 0));
+		d = sqrtf(lanes[lane]);
+	}
+	else
+		d = sqrtf(VF_HorizontalMin(best));
+
+	return (BVH_Inside(b, t, p) ? -d : d);
+}
+
+float Boundary_Distance(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2])
+{
+	return Boundary_Nearest(bd, b, t, p, NULL);
+}
+
+#else
+
+float Boundary_Nearest(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2], int *nearest)
+{
+	float best = 1e30f;
+	int bestseg = 0;
+
+	distancetests += bd->numsegs;
+	for (int i = 0; i < bd->numsegs; i++)
+	{
+		float v[2], s, q[2];
+		float ax = bd->start[0][i], ay = bd->start[1][i];
+		float ex = bd->edge[0][i], ey = bd->edge[1][i];
+
+		v[0] = p[0] - ax;
+		v[1] = p[1] - ay;
+		s = ((v[0] * ex) + (v[1] * ey)) * bd->invlen2[i];
+		s = min(max(s, 0.0f), 1.0f);
+		q[0] = v[0] - s * ex;
+		q[1] = v[1] - s * ey;
+		if ((q[0] * q[0]) + (q[1] * q[1]) < best)
+		{
+			best = (q[0] * q[0]) + (q[1] * q[1]);
+			bestseg = i;
+		}
+	}
+
+	float d = sqrtf(best);
+
+	if (nearest)
+		*nearest = bestseg;
+
+	return (BVH_Inside(b, t, p) ? -d : d);
+}
+
+float Boundary_Distance(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2])
+{
+	return Boundary_Nearest(bd, b, t, p, NULL);
+}
+
+#endif
+
+// gradient of the signed distance from the nearest segment, pointing away
+// from the surface outside and towards it inside
+float Boundary_Gradient(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2], float grad[2])
+{
+	float d, v[2], s, len;
+	int i;
+
+	d = Boundary_Nearest(bd, b, t, p, &i);
+
+	v[0] = p[0] - bd->start[0][i];
+	v[1] = p[1] - bd->start[1][i];
+	s = ((v[0] * bd->edge[0][i]) + (v[1] * bd->edge[1][i])) * bd->invlen2[i];
+	s = min(max(s, 0.0f), 1.0f);
+	v[0] -= s * bd->edge[0][i];
+	v[1] -= s * bd->edge[1][i];
+
+	len = Vec2_Length(v);
+	if (len > 0.0f)
+	{
+		float sign = (d < 0.0f ? -1.0f : 1.0f);
+		grad[0] = sign * v[0] / len;
+		grad[1] = sign * v[1] / len;
+	}
+	else
+	{
+		// on the segment, use its outward normal
+		len = sqrtf(1.0f / bd->invlen2[i]);
+		grad[0] =  bd->edge[1][i] / len;
+		grad[1] = -bd->edge[0][i] / len;
+	}
+
+	return d;
+}
+
+// ==============================================
+// distance queries
+
+const char *distancemodenames[NUM_DISTANCE_MODES] = { "brute", "bvh", "grid", "boundary" };
+int distancemode = dm_brute;
+
+// anything already loaded from the mesh file is used as is. A gridres of 0
+// keeps the file's grid at whatever resolution it was built with, any
+// other value rebuilds it unless it matches.
+void Distance_Init(const mesh_t *m, int gridres)
+{
+	TRACE_ZONE("Distance_Init");
+	if (!cooked.numpadded)
+		Cook_Triangles(&cooked, m);
+	if (!bvh.numnodes)
+		BVH_Build(&bvh, &cooked);
+	if (!grid.cellstart || (gridres && grid.buildres != gridres))
+		Grid_Build(&grid, &bvh, &cooked, gridres ? gridres : GRID_DEFAULT_RES);
+	else
+		printf("grid %i x %i cells from the mesh file, built at %i\n", grid.res[0], grid.res[1], grid.buildres);
+	if (!boundary.start[0])
+		Boundary_Build(&boundary, &bvh, &cooked);
+}
+
+float Distance(float p[2])
+{
+	if (distancemode == dm_bvh)
+		return BVH_Distance(&bvh, &cooked, p);
+	if (distancemode == dm_grid)
+		return Grid_Distance(&grid, p);
+	if (distancemode == dm_boundary)
+		return Boundary_Distance(&boundary, &bvh, &cooked, p);
+
+	return Brute_Distance(p);
+}
+
+void Distance_Batch(float (*p)[2], float *d, int numpoints)
+{
+	Distance_BatchMode(distancemode, p, d, numpoints);
+}
+
+// for threads that must not read distancemode while it may change
+void Distance_BatchMode(int mode, float (*p)[2], float *d, int numpoints)
+{
+	if (mode == dm_bvh)
+	{
+		for (int i = 0; i < numpoints; i++)
+			d[i] = BVH_Distance(&bvh, &cooked, p[i]);
+		return;
+	}
+	if (mode == dm_grid)
+	{
+		for (int i = 0; i < numpoints; i++)
+			d[i] = Grid_Distance(&grid, p[i]);
+		return;
+	}
+	if (mode == dm_boundary)
+	{
+		for (int i = 0; i < numpoints; i++)
+			d[i] = Boundary_Distance(&boundary, &bvh, &cooked, p[i]);
+		return;
+	}
+
+	Brute_DistanceBatch(p, d, numpoints);
+}
+
+void Distance_CycleMode()
+{
+	distancemode = (distancemode + 1) % NUM_DISTANCE_MODES;
+	printf("distance mode: %s\n", distancemodenames[distancemode]);
+}
+
+#if 0
+static float Distance(float p[2], float r)
+{
+	return CircleDistance(p, r);
+}
+#endif
+
+#if 0
+static float Distance(float p[2], float r)
+{
+	float d0, d1;
+
+	float p0[2] = { p[0], p[1] };
+	d0 = CircleDistance(p0, r);
+
+	float p1[2] = { p[0] - 1, p[1] };
+	d1 = CircleDistance(p1, r);
+
+	return (d0 < d1 ? d0 : d1);
+}
+#endif
+
+#if 0
+static float Distance(float p[2], float r)
+{
+	return BoxDistance(p);
+}
+#endif
+
+// distance and the exact gradient of the nearest feature in one query
+float DistanceGradient(float grad[2], float p[2])
+{
+	int nearest;
+
+	if (distancemode == dm_boundary)
+		return Boundary_Gradient(&boundary, &bvh, &cooked, p, grad);
+
+	if (distancemode == dm_bvh)
+		BVH_Nearest(&bvh, &cooked, p, &nearest);
+	else if (distancemode == dm_grid)
+		Grid_Nearest(&grid, p, &nearest);
+	else
+		Brute_Nearest(p, &nearest);
+
+	return CookedTriangleGradient(&cooked, nearest, p, grad);
+}
+
+void Gradient(float grad[2], float p[2])
+{
+	DistanceGradient(grad, p);
+}
@@ -0,0 +1,285 @@
+#include "sdf.h"
+
+// ==============================================
+// baked field
+//
+// Distance() sampled on a regular grid over the world and reconstructed
+// with bilinear interpolation. The field is 1-lipschitz so each corner
+// sample differs from the true value by at most its distance to the query
+// point, and the interpolated value by at most the weighted sum of those
+// distances. That sum peaks at the cell center, giving
+//
+//   |Field_Distance(p) - Distance(p)| <= h * sqrt(2) / 2
+//
+// with h the sample spacing, 12 / (res - 1). The error at the cell centers
+// is measured and printed at build time as an estimate of the real error,
+// which is lower than the bound wherever the field is close to linear.
+
+field_t field;
+
+void Field_Build(field_t *f, int res)
+{
+	TRACE_ZONE("Field_Build");
+	float (*xy)[2];
+
+	f->res = max(2, res);
+	f->spacing = (WORLD_MAX - WORLD_MIN) / (f->res - 1);
+	f->invspacing = 1.0f / f->spacing;
+	f->errorbound = f->spacing * 0.70710678f;
+	f->samples = (float*)Mem_AllocAligned(f->res * f->res * sizeof(float), COOKED_ALIGN, mt_field);
+
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	xy = (float(*)[2])Arena_Alloc(temp, f->res * sizeof(*xy), MEM_ALIGN);
+	for (int y = 0; y < f->res; y++)
+	{
+		for (int x = 0; x < f->res; x++)
+		{
+			xy[x][0] = WORLD_MIN + x * f->spacing;
+			xy[x][1] = WORLD_MIN + y * f->spacing;
+		}
+		Distance_Batch(xy, f->samples + y * f->res, f->res);
+	}
+
+	// estimate the actual error at the cell centers
+	float maxerror = 0.0f;
+	for (int y = 0; y < f->res - 1; y++)
+	{
+		for (int x = 0; x < f->res - 1; x++)
+		{
+			float *s = f->samples + y * f->res + x;
+			float p[2] = { WORLD_MIN + (x + 0.5f) * f->spacing, WORLD_MIN + (y + 0.5f) * f->spacing };
+			float lerp = 0.25f * (s[0] + s[1] + s[f->res] + s[f->res + 1]);
+
+			maxerror = max(maxerror, fabsf(lerp - Distance(p)));
+		}
+	}
+	Arena_Release(temp, mark);
+
+	printf("field %i x %i, %i KB, error bound %f, measured %f\n", f->res, f->res,
+		(int)(f->res * f->res * sizeof(float) / 1024), f->errorbound, maxerror);
+}
+
+// returns false when p is outside the baked domain
+bool Field_Sample(const field_t *f, float p[2], float *d, float grad[2])
+{
+	float fx, fy, u, v;
+	int x, y;
+
+	fx = (p[0] - WORLD_MIN) * f->invspacing;
+	fy = (p[1] - WORLD_MIN) * f->invspacing;
+	if (!(fx >= 0.0f && fy >= 0.0f && fx <= f->res - 1 && fy <= f->res - 1))
+		return false;
+
+	x = min((int)fx, f->res - 2);
+	y = min((int)fy, f->res - 2);
+	u = fx - x;
+	v = fy - y;
+
+	const float *s = f->samples + y * f->res + x;
+	float s00 = s[0], s10 = s[1], s01 = s[f->res], s11 = s[f->res + 1];
+	float bottom = s00 + u * (s10 - s00);
+	float top = s01 + u * (s11 - s01);
+
+	*d = bottom + v * (top - bottom);
+	if (grad)
+	{
+		grad[0] = ((1.0f - v) * (s10 - s00) + v * (s11 - s01)) * f->invspacing;
+		grad[1] = (top - bottom) * f->invspacing;
+	}
+
+	return true;
+}
+
+// ==============================================
+// adaptive distance field
+//
+// a quadtree over the world where each node holds its four corner samples
+// and a leaf reconstructs bilinearly. A node is split when the bilinear
+// reconstruction misses Distance() by more than the tolerance at any of
+// the nine probe points (center, edge midpoints and quarter points), so
+// only the regions near vertices and the medial axis are refined and the
+// nearly linear far field stays coarse. The probes are a sampling check,
+// not a guarantee. ADF_MIN_DEPTH forces enough subdivision that features
+// smaller than the root are not skipped.
+
+#define ADF_MIN_DEPTH		3
+#define ADF_MAX_DEPTH		14
+
+adf_t adf;
+
+static float ADF_Lerp(const float d[4], float u, float v)
+{
+	float bottom = d[0] + u * (d[1] - d[0]);
+	float top = d[2] + u * (d[3] - d[2]);
+
+	return bottom + v * (top - bottom);
+}
+
+static int ADF_AllocNodes(adf_t *a, int count)
+{
+	if (a->numnodes + count > a->maxnodes)
+	{
+		int maxnodes = max(1024, a->maxnodes * 2);
+
+		a->nodes = (adfnode_t*)realloc(a->nodes, maxnodes * sizeof(adfnode_t));
+		Mem_Track(mt_adf, a->maxnodes * sizeof(adfnode_t), maxnodes * sizeof(adfnode_t));
+		a->maxnodes = maxnodes;
+	}
+
+	a->numnodes += count;
+	return a->numnodes - count;
+}
+
+static void ADF_BuildNode(adf_t *a, int nodenum, float mins[2], float size, int depth)
+{
+	float s[3][3], pts[9][2], d[9];
+	float corners[4];
+	float error;
+
+	memcpy(corners, a->nodes[nodenum].d, sizeof(corners));
+	a->nodes[nodenum].children = 0;
+	a->depth = max(a->depth, depth);
+
+	if (depth == ADF_MAX_DEPTH)
+	{
+		a->numleaves++;
+		return;
+	}
+
+	// sample the 3x3 lattice children need plus the four quarter points
+	for (int y = 0; y < 3; y++)
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			pts[y * 3 + x][0] = mins[0] + x * 0.5f * size;
+			pts[y * 3 + x][1] = mins[1] + y * 0.5f * size;
+		}
+	}
+	Distance_Batch(pts, d, 9);
+	for (int i = 0; i < 9; i++)
+		s[i / 3][i % 3] = d[i];
+	s[0][0] = corners[0], s[0][2] = corners[1];
+	s[2][0] = corners[2], s[2][2] = corners[3];
+
+	error = 0.0f;
+	for (int y = 0; y < 3; y++)
+	{
+		for (int x = 0; x < 3; x++)
+			error = max(error, fabsf(ADF_Lerp(corners, x * 0.5f, y * 0.5f) - s[y][x]));
+	}
+
+	if (error <= a->tolerance && depth >= ADF_MIN_DEPTH)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			pts[i][0] = mins[0] + (0.25f + 0.5f * (i & 1)) * size;
+			pts[i][1] = mins[1] + (0.25f + 0.5f * (i >> 1)) * size;
+		}
+		Distance_Batch(pts, d, 4);
+		for (int i = 0; i < 4; i++)
+			error = max(error, fabsf(ADF_Lerp(corners, 0.25f + 0.5f * (i & 1), 0.25f + 0.5f * (i >> 1)) - d[i]));
+
+		if (error <= a->tolerance)
+		{
+			a->numleaves++;
+			return;
+		}
+	}
+
+	// children are allocated together, which may move the node array
+	int first = ADF_AllocNodes(a, 4);
+	a->nodes[nodenum].children = first;
+
+	for (int i = 0; i < 4; i++)
+	{
+		int cx = i & 1, cy = i >> 1;
+		adfnode_t *child = a->nodes + first + i;
+
+		child->d[0] = s[cy + 0][cx + 0];
+		child->d[1] = s[cy + 0][cx + 1];
+		child->d[2] = s[cy + 1][cx + 0];
+		child->d[3] = s[cy + 1][cx + 1];
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		float cmins[2] = { mins[0] + (i & 1) * 0.5f * size, mins[1] + (i >> 1) * 0.5f * size };
+		ADF_BuildNode(a, first + i, cmins, 0.5f * size, depth + 1);
+	}
+}
+
+void ADF_Build(adf_t *a, float tolerance)
+{
+	TRACE_ZONE("ADF_Build");
+	float mins[2] = { WORLD_MIN, WORLD_MIN };
+	float pts[4][2] = { { WORLD_MIN, WORLD_MIN }, { WORLD_MAX, WORLD_MIN }, { WORLD_MIN, WORLD_MAX }, { WORLD_MAX, WORLD_MAX } };
+
+	free(a->nodes);
+	Mem_Track(mt_adf, a->maxnodes * sizeof(adfnode_t), 0);
+	memset(a, 0, sizeof(*a));
+	a->tolerance = tolerance;
+
+	ADF_AllocNodes(a, 1);
+	Distance_Batch(pts, a->nodes[0].d, 4);
+	ADF_BuildNode(a, 0, mins, WORLD_MAX - WORLD_MIN, 0);
+
+	// a uniform grid at the finest depth for comparison
+	float uniform = (float)(1 << a->depth) + 1;
+	uniform = uniform * uniform * sizeof(float);
+
+	printf("adf tolerance %f: %i nodes, %i leaves, depth %i, %i KB (uniform grid at this depth %i KB)\n",
+		a->tolerance, a->numnodes, a->numleaves, a->depth,
+		(int)(a->numnodes * sizeof(adfnode_t) / 1024), (int)(uniform / 1024));
+}
+
+// returns false when p is outside the world
+bool ADF_Sample(const adf_t *a, float p[2], float *d, float grad[2])
+{
+	const adfnode_t *node;
+	float u, v, size;
+
+	u = (p[0] - WORLD_MIN) / (WORLD_MAX - WORLD_MIN);
+	v = (p[1] - WORLD_MIN) / (WORLD_MAX - WORLD_MIN);
+	if (!(u >= 0.0f && v >= 0.0f && u <= 1.0f && v <= 1.0f))
+		return false;
+
+	// descend with u v kept relative to the current node
+	node = a->nodes;
+	size = WORLD_MAX - WORLD_MIN;
+	while (node->children)
+	{
+		int cx = (u >= 0.5f), cy = (v >= 0.5f);
+
+		u = 2.0f * u - cx;
+		v = 2.0f * v - cy;
+		size *= 0.5f;
+		node = a->nodes + node->children + (cy * 2 + cx);
+	}
+
+	*d = ADF_Lerp(node->d, u, v);
+	if (grad)
+	{
+		grad[0] = ((1.0f - v) * (node->d[1] - node->d[0]) + v * (node->d[3] - node->d[2])) / size;
+		grad[1] = ((1.0f - u) * (node->d[2] - node->d[0]) + u * (node->d[3] - node->d[1])) / size;
+	}
+
+	return true;
+}
+
+// steps from the table entry nearest the current tolerance, which may have
+// come from -adftol
+void ADF_CycleTolerance()
+{
+	static const float tolerances[] = { 0.1f, 0.03f, 0.01f, 0.003f, 0.001f };
+	int count = (int)(sizeof(tolerances) / sizeof(tolerances[0]));
+	int index = 0;
+
+	for (int i = 1; i < count; i++)
+	{
+		if (fabsf(logf(tolerances[i] / adf.tolerance)) < fabsf(logf(tolerances[index] / adf.tolerance)))
+			index = i;
+	}
+
+	ADF_Build(&adf, tolerances[(index + 1) % count]);
+}
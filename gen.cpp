@@ -0,0 +1,270 @@
+#include "sdf.h"
+
+// ==============================================
+// synthetic meshes
+//
+// generated scenes for measuring how the queries and bakes scale. Every
+// shape fills the world with close to the asked for number of triangles,
+// and the same shape, count and seed always give the same mesh.
+
+const char *genshapenames[NUM_GEN_SHAPES] = { "polygons", "maze", "clutter", "slivers" };
+
+static unsigned int genseed;
+
+static float Gen_Random()
+{
+	// xorshift32
+	genseed ^= genseed << 13;
+	genseed ^= genseed >> 17;
+	genseed ^= genseed << 5;
+
+	return (genseed >> 8) * (1.0f / (1 << 24));
+}
+
+static void Gen_Alloc(mesh_t *m, int numverts, int numtris)
+{
+	memset(m, 0, sizeof(*m));
+	m->numverts = numverts;
+	m->numtris = numtris;
+	m->verts = (float(*)[2])Mem_Alloc(numverts * sizeof(*m->verts), mt_mesh);
+	m->tris = (int(*)[3])Mem_Alloc(numtris * sizeof(*m->tris), mt_mesh);
+}
+
+// adds an unshared triangle, flipped to be counter clockwise
+static void Gen_Triangle(mesh_t *m, int tri, float v0[2], float v1[2], float v2[2])
+{
+	float (*v)[2] = m->verts + tri * 3;
+	float cross = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+
+	Vec2_Copy(v[0], v0);
+	Vec2_Copy(v[1], cross < 0.0f ? v2 : v1);
+	Vec2_Copy(v[2], cross < 0.0f ? v1 : v2);
+
+	m->tris[tri][0] = tri * 3 + 0;
+	m->tris[tri][1] = tri * 3 + 1;
+	m->tris[tri][2] = tri * 3 + 2;
+}
+
+// convex polygons of 3 to 8 sides, one in each cell of a grid so none
+// overlap. The polygons are fans sharing their vertices.
+static void Gen_Polygons(mesh_t *m, int numtris)
+{
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	unsigned char *sides = (unsigned char*)Arena_Alloc(temp, numtris, MEM_ALIGN);
+	int numpolys = 0, numverts = 0;
+
+	// the sides are picked first to know how many cells are needed
+	for (int t = 0; t < numtris; numpolys++)
+	{
+		int n = 3 + (int)(Gen_Random() * 6);
+
+		sides[numpolys] = min(n, numtris - t + 2);
+		numverts += sides[numpolys];
+		t += sides[numpolys] - 2;
+	}
+
+	int cells = (int)ceilf(sqrtf((float)numpolys));
+	float cellsize = (WORLD_MAX - WORLD_MIN) / cells;
+	int vert = 0, tri = 0;
+
+	Gen_Alloc(m, numverts, numtris);
+	for (int i = 0; i < numpolys; i++)
+	{
+		int n = sides[i];
+		float radius = (0.25f + 0.2f * Gen_Random()) * cellsize;
+		float center[2], start;
+
+		center[0] = WORLD_MIN + ((i % cells) + 0.45f + 0.1f * Gen_Random()) * cellsize;
+		center[1] = WORLD_MIN + ((i / cells) + 0.45f + 0.1f * Gen_Random()) * cellsize;
+
+		// increasing angles around a circle give a convex counter clockwise
+		// polygon
+		start = Gen_Random() * 2.0f * (float)M_PI;
+		for (int j = 0; j < n; j++)
+		{
+			float angle = start + 2.0f * (float)M_PI * (j + 0.8f * Gen_Random()) / n;
+
+			m->verts[vert + j][0] = center[0] + radius * cosf(angle);
+			m->verts[vert + j][1] = center[1] + radius * sinf(angle);
+		}
+
+		for (int j = 1; j < n - 1; j++, tri++)
+		{
+			m->tris[tri][0] = vert;
+			m->tris[tri][1] = vert + j;
+			m->tris[tri][2] = vert + j + 1;
+		}
+		vert += n;
+	}
+
+	Arena_Release(temp, mark);
+}
+
+// a wall from cell corner x y running w h cells, as a rectangle grown by
+// half its thickness so the corners close
+static void Gen_Wall(mesh_t *m, int wall, int x, int y, int w, int h, float cellsize)
+{
+	float thickness = 0.1f * cellsize;
+	float x0 = WORLD_MIN + x * cellsize - 0.5f * thickness;
+	float y0 = WORLD_MIN + y * cellsize - 0.5f * thickness;
+	float x1 = WORLD_MIN + (x + w) * cellsize + 0.5f * thickness;
+	float y1 = WORLD_MIN + (y + h) * cellsize + 0.5f * thickness;
+	float c[4][2] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } };
+
+	Gen_Triangle(m, wall * 2 + 0, c[0], c[1], c[2]);
+	Gen_Triangle(m, wall * 2 + 1, c[0], c[2], c[3]);
+}
+
+// a perfect maze carved by a depth first search. A maze of n x n cells has
+// (n + 1)^2 walls counting the outside, each two triangles, so n is picked
+// to come in just under the asked for count.
+static void Gen_Maze(mesh_t *m, int numtris)
+{
+	int n = max(1, (int)sqrtf(numtris * 0.5f) - 1);
+	float cellsize = (WORLD_MAX - WORLD_MIN) / n;
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+
+	// walls[cell] bit 0 is the east wall, bit 1 the north wall
+	unsigned char *walls = (unsigned char*)Arena_Alloc(temp, n * n, MEM_ALIGN);
+	int *stack = (int*)Arena_Alloc(temp, n * n * sizeof(int), MEM_ALIGN);
+	unsigned char *visited = (unsigned char*)Arena_Alloc(temp, n * n, MEM_ALIGN);
+	int depth = 0;
+
+	memset(walls, 3, n * n);
+	memset(visited, 0, n * n);
+	visited[0] = 1;
+	stack[depth++] = 0;
+	while (depth)
+	{
+		int cell = stack[depth - 1];
+		int x = cell % n, y = cell / n;
+		int next[4], numnext = 0;
+
+		if (x > 0 && !visited[cell - 1])
+			next[numnext++] = cell - 1;
+		if (x < n - 1 && !visited[cell + 1])
+			next[numnext++] = cell + 1;
+		if (y > 0 && !visited[cell - n])
+			next[numnext++] = cell - n;
+		if (y < n - 1 && !visited[cell + n])
+			next[numnext++] = cell + n;
+
+		if (!numnext)
+		{
+			depth--;
+			continue;
+		}
+
+		int pick = (int)(Gen_Random() * numnext);
+		int to = next[min(pick, numnext - 1)];
+		if (to == cell + 1)
+			walls[cell] &= ~1;
+		else if (to == cell - 1)
+			walls[to] &= ~1;
+		else if (to == cell + n)
+			walls[cell] &= ~2;
+		else
+			walls[to] &= ~2;
+
+		visited[to] = 1;
+		stack[depth++] = to;
+	}
+
+	// the outside walls run along the west and south edges, the cells on
+	// the far edges keep their east and north walls
+	int numwalls = 2 * n;
+	for (int i = 0; i < n * n; i++)
+		numwalls += (walls[i] & 1) + ((walls[i] >> 1) & 1);
+	numwalls = min(numwalls, numtris / 2);
+
+	Gen_Alloc(m, numwalls * 6, numwalls * 2);
+	int wall = 0;
+	for (int i = 0; i < n && wall < numwalls; i++)
+		Gen_Wall(m, wall++, 0, i, 0, 1, cellsize);
+	for (int i = 0; i < n && wall < numwalls; i++)
+		Gen_Wall(m, wall++, i, 0, 1, 0, cellsize);
+	for (int i = 0; i < n * n; i++)
+	{
+		if ((walls[i] & 1) && wall < numwalls)
+			Gen_Wall(m, wall++, i % n + 1, i / n, 0, 1, cellsize);
+		if ((walls[i] & 2) && wall < numwalls)
+			Gen_Wall(m, wall++, i % n, i / n + 1, 1, 0, cellsize);
+	}
+
+	Arena_Release(temp, mark);
+}
+
+// overlapping triangles of mixed sizes scattered over the whole world
+static void Gen_Clutter(mesh_t *m, int numtris)
+{
+	float spacing = (WORLD_MAX - WORLD_MIN) / sqrtf((float)numtris);
+
+	Gen_Alloc(m, numtris * 3, numtris);
+	for (int i = 0; i < numtris; i++)
+	{
+		float size = (0.3f + 0.6f * Gen_Random()) * spacing;
+		float center[2], v[3][2];
+
+		size = min(size, 0.25f * (WORLD_MAX - WORLD_MIN));
+		center[0] = WORLD_MIN + size + (WORLD_MAX - WORLD_MIN - 2.0f * size) * Gen_Random();
+		center[1] = WORLD_MIN + size + (WORLD_MAX - WORLD_MIN - 2.0f * size) * Gen_Random();
+		for (int j = 0; j < 3; j++)
+		{
+			float angle = 2.0f * (float)M_PI * (j + 0.6f * Gen_Random()) / 3.0f;
+
+			v[j][0] = center[0] + size * cosf(angle);
+			v[j][1] = center[1] + size * sinf(angle);
+		}
+
+		Gen_Triangle(m, i, v[0], v[1], v[2]);
+	}
+}
+
+// long thin triangles at random angles, one per grid cell, a thousandth as
+// wide as they are long
+static void Gen_Slivers(mesh_t *m, int numtris)
+{
+	int cells = (int)ceilf(sqrtf((float)numtris));
+	float cellsize = (WORLD_MAX - WORLD_MIN) / cells;
+
+	Gen_Alloc(m, numtris * 3, numtris);
+	for (int i = 0; i < numtris; i++)
+	{
+		float angle = 2.0f * (float)M_PI * Gen_Random();
+		float length = (0.4f + 0.4f * Gen_Random()) * cellsize;
+		float dir[2] = { cosf(angle), sinf(angle) };
+		float center[2], v[3][2];
+
+		center[0] = WORLD_MIN + ((i % cells) + 0.5f) * cellsize;
+		center[1] = WORLD_MIN + ((i / cells) + 0.5f) * cellsize;
+
+		v[0][0] = center[0] - 0.5f * length * dir[0];
+		v[0][1] = center[1] - 0.5f * length * dir[1];
+		v[1][0] = center[0] + 0.5f * length * dir[0];
+		v[1][1] = center[1] + 0.5f * length * dir[1];
+		v[2][0] = center[0] - 0.001f * length * dir[1];
+		v[2][1] = center[1] + 0.001f * length * dir[0];
+
+		Gen_Triangle(m, i, v[0], v[1], v[2]);
+	}
+}
+
+void Gen_Mesh(mesh_t *m, int shape, int numtris, unsigned int seed)
+{
+	// xorshift never leaves zero
+	genseed = seed ? seed : 1;
+	numtris = max(1, min(numtris, GEN_MAX_TRIS));
+
+	if (shape == gs_maze)
+		Gen_Maze(m, numtris);
+	else if (shape == gs_clutter)
+		Gen_Clutter(m, numtris);
+	else if (shape == gs_slivers)
+		Gen_Slivers(m, numtris);
+	else
+		Gen_Polygons(m, numtris);
+
+	Mesh_Bounds(m);
+}
@@ -0,0 +1,714 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <float.h>
+#include <locale.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sdf.h"
+#include "triangles.h"
+
+// ==============================================
+// meshes
+
+mesh_t mesh;
+
+void Mesh_Bounds(mesh_t *m)
+{
+	m->mins[0] = m->mins[1] = 1e30f;
+	m->maxs[0] = m->maxs[1] = -1e30f;
+	for (int i = 0; i < m->numverts; i++)
+	{
+		for (int k = 0; k < 2; k++)
+		{
+			m->mins[k] = min(m->mins[k], m->verts[i][k]);
+			m->maxs[k] = max(m->maxs[k], m->verts[i][k]);
+		}
+	}
+}
+
+// the outline compiled in from triangles.h
+void Mesh_Default(mesh_t *m)
+{
+	memset(m, 0, sizeof(*m));
+	m->numverts = sizeof(vertices) / sizeof(vertices[0]);
+	m->verts = vertices;
+	m->numtris = m->numverts / 3;
+	m->tris = (int(*)[3])Mem_Alloc(m->numtris * sizeof(*m->tris), mt_mesh);
+	for (int i = 0; i < m->numtris; i++)
+	{
+		m->tris[i][0] = i * 3 + 0;
+		m->tris[i][1] = i * 3 + 1;
+		m->tris[i][2] = i * 3 + 2;
+	}
+
+	Mesh_Bounds(m);
+}
+
+// ==============================================
+// text meshes
+//
+// streams the dump printed by export_triangles.py, from a file or from a
+// pipe. Each mesh in the dump is an index section of "triangle i a b c"
+// lines followed by a vertex section with one "{ x, y }," line per triangle
+// corner, both introduced by "numtriangles n". The corner positions are
+// stored back through the indices so shared vertices are welded. The input
+// is read in large chunks and the numbers are parsed by hand, scanf would
+// be slower and follows the locale. Everything that is kept goes into the
+// Mem_Alloc arena.
+
+#define TEXT_CHUNK_SIZE		(4 * 1024 * 1024)
+
+enum
+{
+	ts_none,
+	ts_index,
+	ts_vertex
+};
+
+typedef struct textmesh_s
+{
+	int numtris;
+	int (*tris)[3];
+	int numverts;			// highest index + 1
+	float (*verts)[2];
+	int numcorners;			// vertex lines read so far
+
+} textmesh_t;
+
+typedef struct textparse_s
+{
+	const char *filename;
+	int line;
+	int section;
+
+	int nummeshes, maxmeshes;
+	textmesh_t *meshes;
+
+} textparse_t;
+
+static void Text_Error(const textparse_t *tp, const char *message)
+{
+	Error("Mesh: %s:%i: %s\n", tp->filename, tp->line, message);
+}
+
+static const char *Text_SkipSpace(const char *s)
+{
+	while (*s == ' ' || *s == '\t')
+		s++;
+	return s;
+}
+
+// NULL when there is no number
+static const char *Text_ParseInt(const char *s, int *value)
+{
+	bool neg = false;
+	int v = 0;
+
+	s = Text_SkipSpace(s);
+	if (*s == '-' || *s == '+')
+		neg = (*s++ == '-');
+	if (*s < '0' || *s > '9')
+		return NULL;
+
+	for (; *s >= '0' && *s <= '9'; s++)
+		v = v * 10 + (*s - '0');
+
+	*value = (neg ? -v : v);
+	return s;
+}
+
+// strtof in the "C" locale for the numbers the fast path leaves
+static const char *Text_ParseFloatSlow(const char *s, float *value)
+{
+	static locale_t clocale;
+	char *end;
+
+	// strtof_l would skip a newline into the next line
+	if (isspace((unsigned char)*s))
+		return NULL;
+	if (!clocale && !(clocale = newlocale(LC_ALL_MASK, "C", (locale_t)0)))
+		Error("Mesh: newlocale failed\n");
+
+	*value = strtof_l(s, &end, clocale);
+	return (end == s ? NULL : end);
+}
+
+// a decimal of at most 19 significant digits times an exact power of ten
+// is rounded once to the nearest double by the multiply or divide
+// (Clinger's fast path), which covers everything export_triangles.py
+// prints. Rounding that double to float is only wrong when it lands
+// exactly halfway between two floats. That case and anything else the
+// fast path does not cover, longer mantissas, larger exponents,
+// denormals, hex, inf and nan, goes to Text_ParseFloatSlow so the result
+// is always correctly rounded and never follows LC_NUMERIC.
+static const char *Text_ParseFloat(const char *s, float *value)
+{
+	static const double powers[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	uint64_t mantissa = 0, bits;
+	int digits = 0, exponent = 0, e;
+	bool neg = false, any = false;
+	const char *start, *p;
+	double d;
+
+	s = start = Text_SkipSpace(s);
+	if (*s == '-' || *s == '+')
+		neg = (*s++ == '-');
+
+	for (; *s >= '0' && *s <= '9'; s++, any = true)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*s - '0');
+			digits += (mantissa != 0);
+		}
+		else
+			digits++;
+	}
+	if (*s == '.')
+	{
+		for (s++; *s >= '0' && *s <= '9'; s++, any = true, exponent--)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*s - '0');
+				digits += (mantissa != 0);
+			}
+			else
+				digits++;
+		}
+	}
+	if (!any || *s == 'x' || *s == 'X')
+		return Text_ParseFloatSlow(start, value);
+
+	if (*s == 'e' || *s == 'E')
+	{
+		if (!(p = Text_ParseInt(s + 1, &e)) || e < -1000 || e > 1000)
+			return Text_ParseFloatSlow(start, value);
+		s = p;
+		exponent += e;
+	}
+
+	if (digits > 19 || mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+		return Text_ParseFloatSlow(start, value);
+
+	d = (double)mantissa;
+	d = (exponent < 0 ? d / powers[-exponent] : d * powers[exponent]);
+
+	// halfway between two floats when the 29 bits the float drops are
+	// exactly a one followed by zeros
+	memcpy(&bits, &d, sizeof(bits));
+	if ((bits & 0x1fffffff) == 0x10000000 || d > FLT_MAX || (d != 0.0 && d < FLT_MIN))
+		return Text_ParseFloatSlow(start, value);
+
+	*value = (float)(neg ? -d : d);
+	return s;
+}
+
+static bool Text_Prefix(const char *s, const char *prefix, int len)
+{
+	return !strncmp(s, prefix, len);
+}
+
+static void Text_NumTriangles(textparse_t *tp, int n)
+{
+	textmesh_t *tm;
+
+	if (n <= 0)
+		Text_Error(tp, "bad triangle count");
+
+	if (tp->section == ts_index)
+	{
+		if (tp->nummeshes == tp->maxmeshes)
+		{
+			tp->maxmeshes = max(8, tp->maxmeshes * 2);
+			tp->meshes = (textmesh_t*)realloc(tp->meshes, tp->maxmeshes * sizeof(textmesh_t));
+		}
+
+		tm = tp->meshes + tp->nummeshes++;
+		memset(tm, 0, sizeof(*tm));
+		tm->numtris = n;
+		tm->tris = (int(*)[3])Mem_Alloc(n * sizeof(*tm->tris), mt_mesh);
+		memset(tm->tris, 0xff, n * sizeof(*tm->tris));
+		return;
+	}
+
+	if (tp->section != ts_vertex)
+		Text_Error(tp, "numtriangles outside a section");
+
+	// a vertex section without index data is a triangle soup
+	tm = tp->meshes + tp->nummeshes - 1;
+	if (!tp->nummeshes || tm->verts)
+	{
+		tp->section = ts_index;
+		Text_NumTriangles(tp, n);
+		tp->section = ts_vertex;
+
+		tm = tp->meshes + tp->nummeshes - 1;
+		for (int i = 0; i < n; i++)
+		{
+			tm->tris[i][0] = i * 3 + 0;
+			tm->tris[i][1] = i * 3 + 1;
+			tm->tris[i][2] = i * 3 + 2;
+		}
+		tm->numverts = n * 3;
+	}
+
+	if (n != tm->numtris)
+		Text_Error(tp, "vertex section does not match the index section");
+	for (int i = 0; i < n; i++)
+	{
+		if (tm->tris[i][0] < 0 || tm->tris[i][1] < 0 || tm->tris[i][2] < 0)
+			Text_Error(tp, "missing triangle in the index section");
+	}
+
+	tm->verts = (float(*)[2])Mem_Alloc(tm->numverts * sizeof(*tm->verts), mt_mesh);
+	memset(tm->verts, 0, tm->numverts * sizeof(*tm->verts));
+}
+
+static void Text_ParseLine(textparse_t *tp, const char *s)
+{
+	textmesh_t *tm = tp->meshes + tp->nummeshes - 1;
+	int i, n[3];
+	float xy[2] = { 0.0f, 0.0f };
+
+	s = Text_SkipSpace(s);
+	switch (*s)
+	{
+	case '{':
+		if (tp->section != ts_vertex || !tp->nummeshes || !tm->verts)
+			Text_Error(tp, "vertex outside a vertex section");
+		if (tm->numcorners == tm->numtris * 3)
+			Text_Error(tp, "too many vertices");
+		if (!(s = Text_ParseFloat(s + 1, xy + 0)) || *(s = Text_SkipSpace(s)) != ',' ||
+			!(s = Text_ParseFloat(s + 1, xy + 1)))
+			Text_Error(tp, "bad vertex");
+
+		i = tm->tris[tm->numcorners / 3][tm->numcorners % 3];
+		tm->verts[i][0] = xy[0];
+		tm->verts[i][1] = xy[1];
+		tm->numcorners++;
+		break;
+
+	case 't':
+		if (!Text_Prefix(s, "triangle", 8))
+			break;
+		if (tp->section != ts_index || !tp->nummeshes)
+			Text_Error(tp, "triangle outside an index section");
+		if (!(s = Text_ParseInt(s + 8, &i)) || !(s = Text_ParseInt(s, n + 0)) ||
+			!(s = Text_ParseInt(s, n + 1)) || !(s = Text_ParseInt(s, n + 2)))
+			Text_Error(tp, "bad triangle");
+		if (i < 0 || i >= tm->numtris || n[0] < 0 || n[1] < 0 || n[2] < 0)
+			Text_Error(tp, "triangle out of range");
+
+		tm->tris[i][0] = n[0];
+		tm->tris[i][1] = n[1];
+		tm->tris[i][2] = n[2];
+		tm->numverts = max(tm->numverts, max(n[0], max(n[1], n[2])) + 1);
+		break;
+
+	case 'n':
+		if (!Text_Prefix(s, "numtriangles", 12))
+			break;
+		if (!Text_ParseInt(s + 12, &i))
+			Text_Error(tp, "bad triangle count");
+		Text_NumTriangles(tp, i);
+		break;
+
+	case '-':
+		if (Text_Prefix(s, "--- index data", 14))
+			tp->section = ts_index;
+		else if (Text_Prefix(s, "--- vertex data", 15))
+			tp->section = ts_vertex;
+		break;
+
+	default:
+		// the mesh names and anything else maya printed
+		break;
+	}
+}
+
+// the bytes already read from fp to tell text from binary are passed in
+// sniffed, fp may be a pipe that cannot seek back to them
+static void Mesh_LoadText(mesh_t *m, FILE *fp, const char *filename, const void *sniffed, int numsniffed)
+{
+	double start = Sys_Time();
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	char *buffer = (char*)Arena_Alloc(temp, TEXT_CHUNK_SIZE + 1, MEM_ALIGN);
+	long long numbytes = numsniffed;
+	textparse_t tp;
+	int have = numsniffed;
+
+	memset(&tp, 0, sizeof(tp));
+	tp.filename = filename;
+	if (numsniffed)
+		memcpy(buffer, sniffed, numsniffed);
+
+	while (1)
+	{
+		int n = (int)fread(buffer + have, 1, TEXT_CHUNK_SIZE - have, fp);
+		char *s = buffer, *end = buffer + have + n, *nl;
+
+		numbytes += n;
+
+		// every line ends in a newline so the parsers stop without
+		// checking the end of the buffer
+		while ((nl = (char*)memchr(s, '\n', end - s)))
+		{
+			tp.line++;
+			Text_ParseLine(&tp, s);
+			s = nl + 1;
+		}
+
+		have = (int)(end - s);
+		if (!n)
+		{
+			// a last line without a newline
+			if (have)
+			{
+				*end = '\n';
+				tp.line++;
+				Text_ParseLine(&tp, s);
+			}
+			break;
+		}
+		if (have == TEXT_CHUNK_SIZE)
+			Error("Mesh: %s:%i: line too long\n", filename, tp.line + 1);
+		memmove(buffer, s, have);
+	}
+	if (ferror(fp))
+		Error("Mesh: read from \"%s\" failed\n", filename);
+	Arena_Release(temp, mark);
+
+	if (!tp.nummeshes)
+		Error("Mesh: %s: no triangles\n", filename);
+	for (int i = 0; i < tp.nummeshes; i++)
+	{
+		if (tp.meshes[i].numcorners != tp.meshes[i].numtris * 3)
+			Error("Mesh: %s: mesh %i has %i of %i vertices\n", filename, i, tp.meshes[i].numcorners, tp.meshes[i].numtris * 3);
+	}
+
+	// a single mesh is used where it was parsed, several are copied into
+	// one with the indices offset
+	memset(m, 0, sizeof(*m));
+	if (tp.nummeshes == 1)
+	{
+		m->numverts = tp.meshes[0].numverts;
+		m->verts = tp.meshes[0].verts;
+		m->numtris = tp.meshes[0].numtris;
+		m->tris = tp.meshes[0].tris;
+	}
+	else
+	{
+		for (int i = 0; i < tp.nummeshes; i++)
+		{
+			m->numverts += tp.meshes[i].numverts;
+			m->numtris += tp.meshes[i].numtris;
+		}
+		m->verts = (float(*)[2])Mem_Alloc(m->numverts * sizeof(*m->verts), mt_mesh);
+		m->tris = (int(*)[3])Mem_Alloc(m->numtris * sizeof(*m->tris), mt_mesh);
+
+		int firstvert = 0, firsttri = 0;
+		for (int i = 0; i < tp.nummeshes; i++)
+		{
+			textmesh_t *tm = tp.meshes + i;
+
+			memcpy(m->verts + firstvert, tm->verts, tm->numverts * sizeof(*tm->verts));
+			for (int j = 0; j < tm->numtris; j++)
+			{
+				m->tris[firsttri + j][0] = tm->tris[j][0] + firstvert;
+				m->tris[firsttri + j][1] = tm->tris[j][1] + firstvert;
+				m->tris[firsttri + j][2] = tm->tris[j][2] + firstvert;
+			}
+			firstvert += tm->numverts;
+			firsttri += tm->numtris;
+		}
+	}
+	free(tp.meshes);
+	Mesh_Bounds(m);
+
+	double elapsed = Sys_Time() - start;
+	printf("mesh %s: %i meshes, %i vertices, %i triangles, parsed %lli KB in %.2f ms (%.0f MB/s)\n", filename,
+		tp.nummeshes, m->numverts, m->numtris, numbytes / 1024, elapsed * 1000.0, numbytes / elapsed / (1024 * 1024));
+}
+
+// ==============================================
+// binary mesh files
+//
+// a mesh file is a header followed by lumps that are used in place once the
+// file is mapped, there is no parsing and nothing is copied. Besides the
+// vertices and indices a file may carry the cooked triangles, the BVH, the
+// boundary segments and the grid, in which case Distance_Init has nothing
+// left to build. Every lump starts on a MESH_LUMP_ALIGN boundary so the
+// cooked and boundary arrays keep the alignment the SIMD kernels load
+// with. The contents are stored in host byte order and are trusted, only
+// the lump ranges and sizes are checked.
+
+#define MESH_IDENT		(('M' << 24) + ('F' << 16) + ('D' << 8) + 'S')	// "SDFM" little endian
+#define MESH_VERSION		2
+#define MESH_LUMP_ALIGN		64
+
+enum
+{
+	LUMP_VERTICES,			// float[numverts][2]
+	LUMP_INDICES,			// int[numtris][3]
+	LUMP_COOKED,			// the 27 cookedtris_t arrays of numpadded floats
+	LUMP_BVHNODES,			// bvhnode_t
+	LUMP_BVHTRIS,			// int[numtris]
+	LUMP_BOUNDARY,			// the 5 boundary_t arrays of max(numpadded, COOKED_WIDTH) floats
+	LUMP_GRIDCELLS,			// int[cells + 1]
+	LUMP_GRIDTRIS,			// int
+	NUM_MESH_LUMPS
+};
+
+typedef struct meshlump_s
+{
+	int64_t fileofs, filelen;
+
+} meshlump_t;
+
+typedef struct meshheader_s
+{
+	int ident;
+	int version;
+	int numverts, numtris;
+	float mins[2], maxs[2];
+
+	int numsegs;			// boundary segments
+	int gridbuildres;
+	int gridres[2];
+	float gridmins[2];
+	float gridcellsize;
+
+	meshlump_t lumps[NUM_MESH_LUMPS];
+
+} meshheader_t;
+
+// returns NULL for an empty lump
+static void *Mesh_Lump(const mesh_t *m, const meshheader_t *h, int lump, int64_t size, const char *filename)
+{
+	const meshlump_t *l = h->lumps + lump;
+
+	if (!l->filelen)
+		return NULL;
+	if (l->fileofs < (int64_t)sizeof(*h) || l->fileofs % MESH_LUMP_ALIGN || l->filelen != size ||
+		l->fileofs + l->filelen > (int64_t)m->mappedsize)
+		Error("Mesh: %s: bad lump %i\n", filename, lump);
+
+	return (unsigned char*)m->mapped + l->fileofs;
+}
+
+// loads a binary mesh file, or a text dump from a file or from stdin when
+// filename is "-". The acceleration lumps present in a binary file replace
+// the cooked, bvh, boundary and grid globals.
+void Mesh_Load(mesh_t *m, const char *filename)
+{
+	double start = Sys_Time();
+	struct stat st;
+	meshheader_t *h;
+	FILE *fp;
+	int fd, ident = 0, numsniffed;
+
+	if (!strcmp(filename, "-"))
+	{
+		Mesh_LoadText(m, stdin, "<stdin>", NULL, 0);
+		return;
+	}
+
+	fp = fopen(filename, "rb");
+	if (!fp)
+		Error("Mesh: unable to open \"%s\"\n", filename);
+
+	// anything that does not start with the ident is taken as text
+	numsniffed = (int)fread(&ident, 1, sizeof(ident), fp);
+	if (numsniffed != sizeof(ident) || ident != MESH_IDENT)
+	{
+		Mesh_LoadText(m, fp, filename, &ident, numsniffed);
+		fclose(fp);
+		return;
+	}
+	fd = fileno(fp);
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(meshheader_t))
+		Error("Mesh: %s: too short\n", filename);
+
+	memset(m, 0, sizeof(*m));
+	m->mappedsize = st.st_size;
+	m->mapped = mmap(NULL, m->mappedsize, PROT_READ, MAP_PRIVATE, fd, 0);
+	fclose(fp);
+	if (m->mapped == MAP_FAILED)
+		Error("Mesh: unable to map \"%s\"\n", filename);
+	Mem_Track(mt_meshfile, 0, m->mappedsize);
+
+	h = (meshheader_t*)m->mapped;
+	if (h->version != MESH_VERSION)
+		Error("Mesh: %s: version %i, expected %i\n", filename, h->version, MESH_VERSION);
+	if (h->numverts < 0 || h->numtris <= 0)
+		Error("Mesh: %s: bad counts\n", filename);
+
+	m->numverts = h->numverts;
+	m->numtris = h->numtris;
+	m->verts = (float(*)[2])Mesh_Lump(m, h, LUMP_VERTICES, (int64_t)h->numverts * sizeof(*m->verts), filename);
+	m->tris = (int(*)[3])Mesh_Lump(m, h, LUMP_INDICES, (int64_t)h->numtris * sizeof(*m->tris), filename);
+	if (!m->verts || !m->tris)
+		Error("Mesh: %s: no geometry\n", filename);
+	m->mins[0] = h->mins[0], m->mins[1] = h->mins[1];
+	m->maxs[0] = h->maxs[0], m->maxs[1] = h->maxs[1];
+
+	int numpadded = (h->numtris + COOKED_WIDTH - 1) & ~(COOKED_WIDTH - 1);
+	float *f = (float*)Mesh_Lump(m, h, LUMP_COOKED, (int64_t)27 * numpadded * sizeof(float), filename);
+	if (f)
+	{
+		cooked.numtris = h->numtris;
+		cooked.numpadded = numpadded;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++, f += numpadded)
+				cooked.plane[i][j] = f;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
+				for (int k = 0; k < 2; k++, f += numpadded)
+					cooked.skew[i][j][k] = f;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++, f += numpadded)
+				cooked.vert[i][j] = f;
+	}
+
+	const meshlump_t *nodes = h->lumps + LUMP_BVHNODES;
+	if (cooked.numpadded && nodes->filelen)
+	{
+		bvh.numnodes = (int)(nodes->filelen / sizeof(bvhnode_t));
+		bvh.nodes = (bvhnode_t*)Mesh_Lump(m, h, LUMP_BVHNODES, (int64_t)bvh.numnodes * sizeof(bvhnode_t), filename);
+		bvh.numtris = h->numtris;
+		bvh.tris = (int*)Mesh_Lump(m, h, LUMP_BVHTRIS, (int64_t)h->numtris * sizeof(int), filename);
+		if (!bvh.tris)
+			Error("Mesh: %s: bvh without triangles\n", filename);
+	}
+
+	int segspadded = (h->numsegs + COOKED_WIDTH - 1) & ~(COOKED_WIDTH - 1);
+	int segpadded = max(segspadded, COOKED_WIDTH);
+	f = (float*)Mesh_Lump(m, h, LUMP_BOUNDARY, (int64_t)5 * segpadded * sizeof(float), filename);
+	if (f && bvh.numnodes)
+	{
+		boundary.numsegs = h->numsegs;
+		boundary.numpadded = segspadded;
+		boundary.start[0] = f + 0 * segpadded;
+		boundary.start[1] = f + 1 * segpadded;
+		boundary.edge[0] = f + 2 * segpadded;
+		boundary.edge[1] = f + 3 * segpadded;
+		boundary.invlen2 = f + 4 * segpadded;
+	}
+
+	int numcells = h->gridres[0] * h->gridres[1];
+	int *cells = (int*)Mesh_Lump(m, h, LUMP_GRIDCELLS, (int64_t)(numcells + 1) * sizeof(int), filename);
+	if (cells && bvh.numnodes)
+	{
+		grid.buildres = h->gridbuildres;
+		grid.res[0] = h->gridres[0];
+		grid.res[1] = h->gridres[1];
+		grid.mins[0] = h->gridmins[0];
+		grid.mins[1] = h->gridmins[1];
+		grid.cellsize = h->gridcellsize;
+		grid.invcellsize = 1.0f / grid.cellsize;
+		grid.cellstart = cells;
+		grid.tris = (int*)Mesh_Lump(m, h, LUMP_GRIDTRIS, (int64_t)cells[numcells] * sizeof(int), filename);
+		if (!grid.tris && cells[numcells])
+			Error("Mesh: %s: grid without candidates\n", filename);
+	}
+
+	printf("mesh %s: %i vertices, %i triangles, mapped in %.2f ms%s%s%s%s\n", filename, m->numverts, m->numtris,
+		(Sys_Time() - start) * 1000.0, cooked.numpadded ? ", cooked" : "", bvh.numnodes ? ", bvh" : "",
+		boundary.start[0] ? ", boundary" : "", grid.cellstart ? ", grid" : "");
+}
+
+static void Mesh_WriteLump(FILE *fp, meshheader_t *h, int lump, const void *data, int64_t size)
+{
+	static const unsigned char zeros[MESH_LUMP_ALIGN] = { 0 };
+	int64_t ofs = ftello(fp);
+	int pad = (int)((MESH_LUMP_ALIGN - ofs % MESH_LUMP_ALIGN) % MESH_LUMP_ALIGN);
+
+	fwrite(zeros, 1, pad, fp);
+	h->lumps[lump].fileofs = ofs + pad;
+	h->lumps[lump].filelen = size;
+	fwrite(data, 1, size, fp);
+}
+
+// accel also writes the cooked triangles, bvh, boundary and grid, which
+// must have been built for this mesh by Distance_Init
+void Mesh_Write(const mesh_t *m, const char *filename, bool accel)
+{
+	meshheader_t h;
+	FILE *fp;
+
+	fp = fopen(filename, "wb");
+	if (!fp)
+		Error("Mesh: unable to open \"%s\" for writing\n", filename);
+
+	memset(&h, 0, sizeof(h));
+	h.ident = MESH_IDENT;
+	h.version = MESH_VERSION;
+	h.numverts = m->numverts;
+	h.numtris = m->numtris;
+	h.mins[0] = m->mins[0], h.mins[1] = m->mins[1];
+	h.maxs[0] = m->maxs[0], h.maxs[1] = m->maxs[1];
+
+	// the header is rewritten once the lump offsets are known
+	fwrite(&h, sizeof(h), 1, fp);
+	Mesh_WriteLump(fp, &h, LUMP_VERTICES, m->verts, (int64_t)m->numverts * sizeof(*m->verts));
+	Mesh_WriteLump(fp, &h, LUMP_INDICES, m->tris, (int64_t)m->numtris * sizeof(*m->tris));
+
+	if (accel)
+	{
+		int64_t size = (int64_t)cooked.numpadded * sizeof(float);
+		int segpadded = max(boundary.numpadded, COOKED_WIDTH);
+		int numcells = grid.res[0] * grid.res[1];
+
+		if (cooked.numtris != m->numtris || !bvh.numnodes || !boundary.start[0] || !grid.cellstart)
+			Error("Mesh: acceleration structures not built\n");
+
+		// the cooked and boundary arrays are separate allocations, each
+		// follows the previous directly so they keep their alignment
+		Mesh_WriteLump(fp, &h, LUMP_COOKED, cooked.plane[0][0], size);
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				if (i || j)
+					fwrite(cooked.plane[i][j], 1, size, fp);
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
+				for (int k = 0; k < 2; k++)
+					fwrite(cooked.skew[i][j][k], 1, size, fp);
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
+				fwrite(cooked.vert[i][j], 1, size, fp);
+		h.lumps[LUMP_COOKED].filelen = 27 * size;
+
+		Mesh_WriteLump(fp, &h, LUMP_BVHNODES, bvh.nodes, (int64_t)bvh.numnodes * sizeof(bvhnode_t));
+		Mesh_WriteLump(fp, &h, LUMP_BVHTRIS, bvh.tris, (int64_t)bvh.numtris * sizeof(int));
+
+		size = (int64_t)segpadded * sizeof(float);
+		Mesh_WriteLump(fp, &h, LUMP_BOUNDARY, boundary.start[0], size);
+		fwrite(boundary.start[1], 1, size, fp);
+		fwrite(boundary.edge[0], 1, size, fp);
+		fwrite(boundary.edge[1], 1, size, fp);
+		fwrite(boundary.invlen2, 1, size, fp);
+		h.lumps[LUMP_BOUNDARY].filelen = 5 * size;
+		h.numsegs = boundary.numsegs;
+
+		Mesh_WriteLump(fp, &h, LUMP_GRIDCELLS, grid.cellstart, (int64_t)(numcells + 1) * sizeof(int));
+		Mesh_WriteLump(fp, &h, LUMP_GRIDTRIS, grid.tris, (int64_t)grid.cellstart[numcells] * sizeof(int));
+		h.gridbuildres = grid.buildres;
+		h.gridres[0] = grid.res[0];
+		h.gridres[1] = grid.res[1];
+		h.gridmins[0] = grid.mins[0];
+		h.gridmins[1] = grid.mins[1];
+		h.gridcellsize = grid.cellsize;
+	}
+
+	fseeko(fp, 0, SEEK_SET);
+	fwrite(&h, sizeof(h), 1, fp);
+	if (ferror(fp) | fclose(fp))
+		Error("Mesh: write to \"%s\" failed\n", filename);
+}
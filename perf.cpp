@@ -0,0 +1,162 @@
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "sdf.h"
+
+// ==============================================
+// hardware counters
+//
+// cycles, instructions, cache misses and branch misses from perf_event_open.
+// Every thread gets its own counters the first time it reads them and they
+// then run freely, so a phase is measured as the difference between two
+// reads and phases can nest or overlap. The pool workers add what they
+// count while running jobs to a shared total that the phases include, so a
+// phase around Threads_Run covers every thread of the run, but also any
+// other run made on another thread at the same time.
+//
+// perf events are often unavailable in containers or with a strict
+// perf_event_paranoid, in which case the counts are reported as -1. When
+// there are more counters than the cpu has the kernel multiplexes them and
+// the counts are scaled from the time each was running.
+
+const char *perfcounternames[NUM_PERF_COUNTERS] = { "cycles", "instructions", "l1dmisses", "llcmisses", "branchmisses" };
+
+bool perfenabled;
+
+static __thread bool perfopened;
+static __thread int perffds[NUM_PERF_COUNTERS];
+static long long perfworkers[NUM_PERF_COUNTERS];
+
+static void Perf_OpenThread()
+{
+	static const unsigned int types[NUM_PERF_COUNTERS] =
+	{
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HW_CACHE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE
+	};
+	static const unsigned long long configs[NUM_PERF_COUNTERS] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+	{
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[i];
+		attr.config = configs[i];
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		perffds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	perfopened = true;
+}
+
+// opens the counters for the calling thread and turns them on for the
+// threads that read them later
+void Perf_Init()
+{
+	char missing[128];
+	int len = 0;
+
+	perfenabled = true;
+	Perf_OpenThread();
+
+	missing[0] = 0;
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+	{
+		if (perffds[i] < 0)
+			len += snprintf(missing + len, sizeof(missing) - len, " %s", perfcounternames[i]);
+	}
+	if (len)
+		Warning("Perf: perf_event_open failed for%s\n", missing);
+}
+
+// the calling thread's running counts, -1 for the unavailable counters
+void Perf_Read(long long counts[NUM_PERF_COUNTERS])
+{
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+		counts[i] = -1;
+
+	if (!perfenabled)
+		return;
+	if (!perfopened)
+		Perf_OpenThread();
+
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+	{
+		unsigned long long v[3];	// value, time enabled, time running
+
+		if (perffds[i] < 0 || read(perffds[i], v, sizeof(v)) != sizeof(v))
+			continue;
+
+		if (v[2] && v[2] < v[1])
+			counts[i] = (long long)((double)v[0] * v[1] / v[2]);
+		else
+			counts[i] = (long long)v[0];
+	}
+}
+
+void Perf_Begin(perfsample_t *s)
+{
+	Perf_Read(s->thread);
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+		s->workers[i] = __atomic_load_n(&perfworkers[i], __ATOMIC_RELAXED);
+}
+
+// adds what was counted since Perf_Begin to the phase
+void Perf_End(perfphase_t *p, const perfsample_t *s)
+{
+	long long now[NUM_PERF_COUNTERS];
+
+	Perf_Read(now);
+	p->calls++;
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+	{
+		if (now[i] < 0 || s->thread[i] < 0)
+			p->counts[i] = -1;
+		else if (p->counts[i] >= 0)
+			p->counts[i] += now[i] - s->thread[i] + __atomic_load_n(&perfworkers[i], __ATOMIC_RELAXED) - s->workers[i];
+	}
+}
+
+// for the pool workers, adds the counts since Perf_Read to the shared total
+void Perf_AddWorker(const long long start[NUM_PERF_COUNTERS])
+{
+	long long now[NUM_PERF_COUNTERS];
+
+	Perf_Read(now);
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+	{
+		if (now[i] >= 0 && start[i] >= 0)
+			__atomic_fetch_add(&perfworkers[i], now[i] - start[i], __ATOMIC_RELAXED);
+	}
+}
+
+void Perf_Reset(perfphase_t *p)
+{
+	p->calls = 0;
+	memset(p->counts, 0, sizeof(p->counts));
+}
+
+// instructions per cycle, -1 when either counter is missing
+double Perf_IPC(const perfphase_t *p)
+{
+	if (p->counts[pc_cycles] <= 0 || p->counts[pc_instructions] < 0)
+		return -1.0;
+
+	return (double)p->counts[pc_instructions] / p->counts[pc_cycles];
+}
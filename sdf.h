@@ -0,0 +1,445 @@
+// shared by the interactive viewer and the command line tools. Nothing
+// here depends on GL.
+
+#ifndef __SDF_H__
+#define __SDF_H__
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <stdint.h>
+
+#undef min
+#define min(a, b) (a < b ? a : b)
+
+#undef max
+#define max(a, b) (a > b ? a : b)
+
+// ==============================================
+// common.cpp
+
+typedef struct arena_s
+{
+	const char *name;
+	unsigned char *base;
+	size_t size;			// reserved address space
+	size_t commitsize;		// granularity of commits
+	size_t committed;		// bytes from base that are backed
+	size_t used;
+	size_t peak;			// high water mark of used
+
+} arena_t;
+
+void Arena_Reserve(arena_t *a, const char *name, size_t size, bool hugepages);
+void *Arena_Alloc(arena_t *a, size_t numbytes, int align);
+size_t Arena_Mark(const arena_t *a);
+void Arena_Release(arena_t *a, size_t mark);
+
+#define MEM_ALIGN	16
+
+// set before the first allocation to back the arenas with huge pages
+extern bool memhugepages;
+
+// what an allocation is for, so the memory use of each subsystem can be
+// reported
+enum memtag_t
+{
+	mt_mesh,
+	mt_meshfile,			// mapped mesh file, not from an arena
+	mt_cooked,
+	mt_bvh,
+	mt_grid,
+	mt_boundary,
+	mt_field,
+	mt_adf,				// grown with realloc, not from an arena
+	NUM_MEM_TAGS
+};
+
+typedef struct memtagstats_s
+{
+	size_t live;
+	size_t peak;
+	int count;			// allocations made
+
+} memtagstats_t;
+
+extern const char *memtagnames[NUM_MEM_TAGS];
+
+void *Mem_Alloc(int numbytes, int tag);
+void *Mem_AllocAligned(int numbytes, int align, int tag);
+void Mem_Track(int tag, size_t oldbytes, size_t newbytes);
+const memtagstats_t *Mem_TagStats(int tag);
+void Mem_PrintStats();
+arena_t *Mem_Temp();
+arena_t *Mem_Frame();
+void Mem_ResetFrame();
+
+void Error(const char *error, ...);
+void Warning(const char *warning, ...);
+
+double Sys_Time();
+
+// ==============================================
+// vector utils
+
+static inline void Vec2_Copy(float a[2], float b[2])
+{
+	a[0] = b[0];
+	a[1] = b[1];
+}
+
+static inline void Vec2_Normalize(float *v)
+{
+	float len, invlen;
+
+	len = sqrtf((v[0] * v[0]) + (v[1] * v[1]));
+	invlen = 1.0f / len;
+
+	v[0] *= invlen;
+	v[1] *= invlen;
+}
+
+// return the circular distance
+static inline float Vec2_Length(float v[2])
+{
+	return sqrtf((v[0] * v[0]) + (v[1] * v[1]));
+}
+
+static inline float Vec2_Dot(float a[2], float b[2])
+{
+	return (a[0] * b[0]) + (a[1] * b[1]);
+}
+
+// ==============================================
+// mesh.cpp
+
+// an indexed triangle mesh, either built in or mapped from a mesh file
+typedef struct mesh_s
+{
+	int numverts;
+	float (*verts)[2];
+	int numtris;
+	int (*tris)[3];
+	float mins[2], maxs[2];
+
+	void *mapped;			// the whole file when loaded by Mesh_Load
+	size_t mappedsize;
+
+} mesh_t;
+
+extern mesh_t mesh;
+
+void Mesh_Bounds(mesh_t *m);
+void Mesh_Default(mesh_t *m);
+void Mesh_Load(mesh_t *m, const char *filename);
+void Mesh_Write(const mesh_t *m, const char *filename, bool accel);
+
+// ==============================================
+// gen.cpp
+
+enum genshape_t
+{
+	gs_polygons,
+	gs_maze,
+	gs_clutter,
+	gs_slivers,
+	NUM_GEN_SHAPES
+};
+
+#define GEN_MAX_TRIS	(1 << 24)
+
+extern const char *genshapenames[NUM_GEN_SHAPES];
+
+void Gen_Mesh(mesh_t *m, int shape, int numtris, unsigned int seed);
+
+// ==============================================
+// distance.cpp
+
+#define COOKED_ALIGN	32
+#define COOKED_WIDTH	8
+
+typedef struct cookedtris_s
+{
+	int numtris;
+	int numpadded;			// numtris rounded up to COOKED_WIDTH
+
+	float *plane[3][3];		// edge planes (v0 v1), (v1 v2), (v2 v0) as abc
+	float *skew[3][2][2];		// the two normals bounding each vertex region
+	float *vert[3][2];
+
+} cookedtris_t;
+
+typedef struct bvhnode_s
+{
+	float mins[2], maxs[2];
+	int first;			// first child for interior nodes, first bvh.tris entry for leaves
+	int count;			// 0 for interior nodes
+
+} bvhnode_t;
+
+typedef struct bvh_s
+{
+	int numnodes;
+	bvhnode_t *nodes;
+	int numtris;
+	int *tris;			// cooked triangle indices in leaf order
+
+} bvh_t;
+
+#define GRID_DEFAULT_RES	64
+
+typedef struct grid_s
+{
+	int buildres;			// cells along the longest axis asked of Grid_Build
+	int res[2];
+	float mins[2];
+	float cellsize, invcellsize;
+	int *cellstart;			// res[0] * res[1] + 1 offsets into tris
+	int *tris;
+
+} grid_t;
+
+typedef struct boundary_s
+{
+	int numsegs;
+	int numpadded;			// numsegs rounded up to COOKED_WIDTH
+
+	float *start[2];
+	float *edge[2];			// end - start
+	float *invlen2;			// 1 / |edge|^2, 0 for the padding
+
+} boundary_t;
+
+enum distancemode_t
+{
+	dm_brute,
+	dm_bvh,
+	dm_grid,
+	dm_boundary,
+	NUM_DISTANCE_MODES
+};
+
+extern cookedtris_t cooked;
+extern bvh_t bvh;
+extern grid_t grid;
+extern boundary_t boundary;
+extern const char *distancemodenames[NUM_DISTANCE_MODES];
+extern int distancemode;
+extern __thread unsigned int distancetests;
+
+void Plane2d(float abc[3], float a[2], float b[2]);
+float PlaneDistance(float abc[3], float xy[2]);
+float TriangleDistance(float p[2], float v0[2], float v1[2], float v2[2]);
+
+void Cook_Triangles(cookedtris_t *t, const mesh_t *m);
+float CookedTriangleDistance(const cookedtris_t *t, int i, float p[2]);
+float CookedTriangleGradient(const cookedtris_t *t, int i, float p[2], float grad[2]);
+
+float Brute_Distance(float p[2]);
+float Brute_Nearest(float p[2], int *nearest);
+void Brute_DistanceBatch(float (*p)[2], float *d, int numpoints);
+
+void BVH_TriangleBounds(const cookedtris_t *t, int tri, float mins[2], float maxs[2]);
+void BVH_Build(bvh_t *b, const cookedtris_t *t);
+float BVH_Nearest(const bvh_t *b, const cookedtris_t *t, float p[2], int *nearest);
+float BVH_Distance(const bvh_t *b, const cookedtris_t *t, float p[2]);
+bool BVH_Inside(const bvh_t *b, const cookedtris_t *t, float p[2]);
+void BVH_Collect(const bvh_t *b, const cookedtris_t *t, float p[2], float maxdist, void (*func)(int tri, void *data), void *data);
+
+void Grid_Build(grid_t *g, const bvh_t *b, const cookedtris_t *t, int res);
+float Grid_Nearest(const grid_t *g, float p[2], int *nearest);
+float Grid_Distance(const grid_t *g, float p[2]);
+
+void Boundary_Build(boundary_t *bd, const bvh_t *b, const cookedtris_t *t);
+float Boundary_Nearest(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2], int *nearest);
+float Boundary_Distance(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2]);
+float Boundary_Gradient(const boundary_t *bd, const bvh_t *b, const cookedtris_t *t, float p[2], float grad[2]);
+
+// cooks the triangles and builds every acceleration structure, gridres 0
+// keeps a loaded grid or builds one at GRID_DEFAULT_RES
+void Distance_Init(const mesh_t *m, int gridres);
+float Distance(float p[2]);
+void Distance_Batch(float (*p)[2], float *d, int numpoints);
+void Distance_BatchMode(int mode, float (*p)[2], float *d, int numpoints);
+void Distance_CycleMode();
+float DistanceGradient(float grad[2], float p[2]);
+void Gradient(float grad[2], float p[2]);
+
+// ==============================================
+// field.cpp
+
+#define WORLD_MIN		-6.0f
+#define WORLD_MAX		6.0f
+
+#define FIELD_DEFAULT_RES	256
+
+typedef struct field_s
+{
+	int res;			// samples per axis, covering [WORLD_MIN, WORLD_MAX]
+	float spacing, invspacing;
+	float *samples;			// res * res, row major from WORLD_MIN
+	float errorbound;
+
+} field_t;
+
+#define ADF_DEFAULT_TOLERANCE	0.01f
+
+typedef struct adfnode_s
+{
+	float d[4];			// corners (0 0) (1 0) (0 1) (1 1)
+	int children;			// first of four children, 0 for a leaf
+
+} adfnode_t;
+
+typedef struct adf_s
+{
+	float tolerance;
+	int numnodes, maxnodes;
+	adfnode_t *nodes;
+	int numleaves;
+	int depth;
+
+} adf_t;
+
+extern field_t field;
+extern adf_t adf;
+
+void Field_Build(field_t *f, int res);
+bool Field_Sample(const field_t *f, float p[2], float *d, float grad[2]);
+
+void ADF_Build(adf_t *a, float tolerance);
+bool ADF_Sample(const adf_t *a, float p[2], float *d, float grad[2]);
+void ADF_CycleTolerance();
+
+// ==============================================
+// threads.cpp
+
+#define MAX_THREADS	64
+
+typedef void (*jobfunc_t)(int job, int thread, void *data);
+
+typedef struct workrange_s
+{
+	pthread_mutex_t lock;
+	int head, tail;
+
+} workrange_t;
+
+typedef struct threadpool_s
+{
+	int numthreads;
+	pthread_t threads[MAX_THREADS];
+
+	pthread_mutex_t runlock;		// one Threads_Run at a time
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	int generation;
+	int running;			// workers still busy in this generation
+
+	jobfunc_t func;
+	void *data;
+	workrange_t ranges[MAX_THREADS];
+
+} threadpool_t;
+
+extern threadpool_t pool;
+
+// count 0 picks the number of cores
+void Threads_Init(int count);
+void Threads_Run(int numjobs, jobfunc_t func, void *data);
+
+// ==============================================
+// trace.cpp
+
+void Trace_Start(const char *filename);
+void Trace_ThreadName(const char *name);
+void Trace_Begin(const char *name);
+void Trace_End();
+void Trace_Write(const char *filename);
+void Trace_Flush();
+
+// times the rest of the enclosing scope, only built in with TRACE defined
+#ifdef TRACE
+typedef struct tracezone_s
+{
+	tracezone_s(const char *name) { Trace_Begin(name); }
+	~tracezone_s() { Trace_End(); }
+
+} tracezone_t;
+
+#define TRACE_CONCAT2(a, b)	a##b
+#define TRACE_CONCAT(a, b)	TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(name)	tracezone_t TRACE_CONCAT(tracezone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
+
+// ==============================================
+// perf.cpp
+
+enum perfcounter_t
+{
+	pc_cycles,
+	pc_instructions,
+	pc_l1dmisses,
+	pc_llcmisses,
+	pc_branchmisses,
+	NUM_PERF_COUNTERS
+};
+
+// counter reads taken by Perf_Begin
+typedef struct perfsample_s
+{
+	long long thread[NUM_PERF_COUNTERS];
+	long long workers[NUM_PERF_COUNTERS];
+
+} perfsample_t;
+
+// counts summed over every Perf_Begin Perf_End pair, -1 when not counted
+typedef struct perfphase_s
+{
+	int calls;
+	long long counts[NUM_PERF_COUNTERS];
+
+} perfphase_t;
+
+extern const char *perfcounternames[NUM_PERF_COUNTERS];
+extern bool perfenabled;
+
+void Perf_Init();
+void Perf_Read(long long counts[NUM_PERF_COUNTERS]);
+void Perf_Begin(perfsample_t *s);
+void Perf_End(perfphase_t *p, const perfsample_t *s);
+void Perf_AddWorker(const long long start[NUM_PERF_COUNTERS]);
+void Perf_Reset(perfphase_t *p);
+double Perf_IPC(const perfphase_t *p);
+
+// ==============================================
+// bake.cpp
+
+enum bakebackend_t
+{
+	bb_exact,
+	bb_sweep,
+	NUM_BAKE_BACKENDS
+};
+
+extern const char *bakebackendnames[NUM_BAKE_BACKENDS];
+extern int bakebackend;
+extern float bakemins[2], bakemaxs[2];
+
+#define BAKE_TILE_SIZE		64
+
+void Bake_TexelToWorld(int texw, int texh, float x, float y, float xy[2]);
+void Bake_Sweep(float *out, int texw, int texh);
+float *BuildFieldData(arena_t *arena, int texw, int texh);
+void ColorizeField(unsigned char *data, const float *d, int count);
+unsigned char *BuildTextureData(arena_t *arena, int texw, int texh);
+
+#endif
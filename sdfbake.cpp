@@ -0,0 +1,247 @@
+// bakes the signed distance field of the mesh to a file without a display.
+// Uses the same distance queries and bake backends as sdfield6.
+
+#include "sdf.h"
+
+// texels sampled by -checkerror
+#define CHECK_ERROR_STRIDE	17
+
+enum bakeformat_t
+{
+	bf_raw,
+	bf_pfm,
+	bf_pgm,
+	NUM_BAKE_FORMATS
+};
+
+static const char *bakeformatnames[NUM_BAKE_FORMATS] = { "raw", "pfm", "pgm" };
+
+static int texsize[2] = { 256, 256 };
+static int format = -1;			// -1 picks from the file extension
+static float pgmrange = 1.0f;
+static int gridres;			// 0 keeps the grid from the mesh file
+static int numthreads;			// 0 picks the number of cores
+static const char *meshname;		// NULL for the built in outline
+static const char *savemeshname;
+static const char *tracename;		// NULL when not tracing
+static bool checkerror;
+static const char *outname;
+
+// matches the extension, falling back to raw
+static int FormatForFile(const char *filename)
+{
+	const char *ext = strrchr(filename, '.');
+
+	for (int i = 0; ext && i < NUM_BAKE_FORMATS; i++)
+	{
+		if (!strcmp(ext + 1, bakeformatnames[i]))
+			return i;
+	}
+
+	return bf_raw;
+}
+
+// float32 in native byte order, rows from bakemins[1] upwards
+static void WriteRaw(FILE *fp, const float *d, int texw, int texh)
+{
+	fwrite(d, sizeof(float), texw * texh, fp);
+}
+
+// the pfm scale is negative for little endian data. Rows are stored bottom
+// to top which is the order the bake produces them in.
+static void WritePFM(FILE *fp, const float *d, int texw, int texh)
+{
+	uint16_t one = 1;
+	bool little = *(unsigned char*)&one == 1;
+
+	fprintf(fp, "Pf\n%i %i\n%s\n", texw, texh, little ? "-1.0" : "1.0");
+	fwrite(d, sizeof(float), texw * texh, fp);
+}
+
+// 8 bit grey with zero at 128, clamped to +-pgmrange. pgm rows run top to
+// bottom so the image is flipped.
+static void WritePGM(FILE *fp, const float *d, int texw, int texh)
+{
+	unsigned char *row = (unsigned char*)malloc(texw);
+
+	fprintf(fp, "P5\n%i %i\n255\n", texw, texh);
+	for (int y = texh - 1; y >= 0; y--)
+	{
+		for (int x = 0; x < texw; x++)
+		{
+			float dd = max(-1.0f, min(d[y * texw + x] / pgmrange, 1.0f));
+			row[x] = (unsigned char)(128.0f + dd * 127.0f);
+		}
+		fwrite(row, 1, texw, fp);
+	}
+
+	free(row);
+}
+
+// the largest difference from the boundary kernel over a sample of the
+// texels, which is the distance to the triangle union up to the rounding
+// of the boundary split points. Kept out of the timings as it costs a
+// query per sample.
+static float CheckError(const float *d, int texw, int texh)
+{
+	float maxerror = 0.0f;
+
+	for (int i = 0; i < texw * texh; i += CHECK_ERROR_STRIDE)
+	{
+		float p[2];
+
+		Bake_TexelToWorld(texw, texh, (float)(i % texw), (float)(i / texw), p);
+		float error = fabsf(d[i] - Boundary_Distance(&boundary, &bvh, &cooked, p));
+		maxerror = max(maxerror, error);
+	}
+
+	return maxerror;
+}
+
+static void PrintUsage()
+{
+	printf("usage: sdfbake [options] <output>\n");
+	printf("  -mesh <file>           mesh file to bake instead of the built in outline\n");
+	printf("  -savemesh <file>       write the mesh with its acceleration structures\n");
+	printf("  -size <w> <h>          texels (default %i %i)\n", texsize[0], texsize[1]);
+	printf("  -domain <x0> <y0> <x1> <y1>  world area baked (default %g %g %g %g)\n", WORLD_MIN, WORLD_MIN, WORLD_MAX, WORLD_MAX);
+	printf("  -format <raw|pfm|pgm>  output format (default from the extension, else raw)\n");
+	printf("  -pgmrange <r>          distance mapped to black and white in pgm output (default %g)\n", pgmrange);
+	printf("  -backend <exact|sweep> bake backend (default exact)\n");
+	printf("  -mode <brute|bvh|grid|boundary>  distance query for the exact backend (default grid when the mesh file has one, else bvh)\n");
+	printf("  -gridres <n>           uniform grid cells along the longest mesh axis (default the mesh file's grid, else %i)\n", GRID_DEFAULT_RES);
+	printf("  -threads <n>           worker threads, 0 for one per core (default 0)\n");
+	printf("  -hugepages             back the memory arenas with transparent huge pages\n");
+	printf("  -trace <file>          write a chrome trace of the zones at exit, needs make TRACE=1\n");
+	printf("  -checkerror            after baking report the largest difference from the boundary kernel\n");
+}
+
+static int LookupName(const char *name, const char **names, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (!strcmp(name, names[i]))
+			return i;
+	}
+
+	Error("unknown name \"%s\"\n", name);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double t0, t1, t2, t3;
+
+	// -1 picks from what the mesh file carries
+	distancemode = -1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-mesh") && i + 1 < argc)
+			meshname = argv[++i];
+		else if (!strcmp(argv[i], "-savemesh") && i + 1 < argc)
+			savemeshname = argv[++i];
+		else if (!strcmp(argv[i], "-size") && i + 2 < argc)
+		{
+			texsize[0] = atoi(argv[++i]);
+			texsize[1] = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-domain") && i + 4 < argc)
+		{
+			bakemins[0] = (float)atof(argv[++i]);
+			bakemins[1] = (float)atof(argv[++i]);
+			bakemaxs[0] = (float)atof(argv[++i]);
+			bakemaxs[1] = (float)atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-format") && i + 1 < argc)
+			format = LookupName(argv[++i], bakeformatnames, NUM_BAKE_FORMATS);
+		else if (!strcmp(argv[i], "-pgmrange") && i + 1 < argc)
+			pgmrange = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-backend") && i + 1 < argc)
+			bakebackend = LookupName(argv[++i], bakebackendnames, NUM_BAKE_BACKENDS);
+		else if (!strcmp(argv[i], "-mode") && i + 1 < argc)
+			distancemode = LookupName(argv[++i], distancemodenames, NUM_DISTANCE_MODES);
+		else if (!strcmp(argv[i], "-gridres") && i + 1 < argc)
+			gridres = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			numthreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-hugepages"))
+			memhugepages = true;
+		else if (!strcmp(argv[i], "-trace") && i + 1 < argc)
+			tracename = argv[++i];
+		else if (!strcmp(argv[i], "-checkerror"))
+			checkerror = true;
+		else if (argv[i][0] != '-' && !outname)
+			outname = argv[i];
+		else
+		{
+			PrintUsage();
+			return (strcmp(argv[i], "-help") ? 1 : 0);
+		}
+	}
+
+	// min and max evaluate their arguments twice so clamp after parsing
+	texsize[0] = max(1, texsize[0]);
+	texsize[1] = max(1, texsize[1]);
+	pgmrange = max(1e-6f, pgmrange);
+	gridres = max(0, gridres);
+
+	if (!outname)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (!(bakemaxs[0] > bakemins[0] && bakemaxs[1] > bakemins[1]))
+		Error("empty domain\n");
+	if (format < 0)
+		format = FormatForFile(outname);
+
+	t0 = Sys_Time();
+	if (tracename)
+	{
+		Trace_Start(tracename);
+		atexit(Trace_Flush);
+	}
+	Threads_Init(numthreads);
+	atexit(Mem_PrintStats);
+	if (meshname)
+		Mesh_Load(&mesh, meshname);
+	else
+		Mesh_Default(&mesh);
+
+	// brute and boundary test every triangle or segment per texel, the
+	// grid is only built here when the file lacks one
+	if (distancemode < 0)
+		distancemode = (grid.cellstart ? dm_grid : dm_bvh);
+	Distance_Init(&mesh, gridres);
+	if (savemeshname)
+		Mesh_Write(&mesh, savemeshname, true);
+
+	t1 = Sys_Time();
+	float *d = BuildFieldData(Mem_Temp(), texsize[0], texsize[1]);
+
+	t2 = Sys_Time();
+	FILE *fp = fopen(outname, "wb");
+	if (!fp)
+		Error("unable to open \"%s\" for writing\n", outname);
+
+	if (format == bf_pfm)
+		WritePFM(fp, d, texsize[0], texsize[1]);
+	else if (format == bf_pgm)
+		WritePGM(fp, d, texsize[0], texsize[1]);
+	else
+		WriteRaw(fp, d, texsize[0], texsize[1]);
+
+	if (ferror(fp) | fclose(fp))
+		Error("write to \"%s\" failed\n", outname);
+	t3 = Sys_Time();
+
+	printf("%s: %i x %i %s, %s backend, %s queries\n", outname, texsize[0], texsize[1],
+		bakeformatnames[format], bakebackendnames[bakebackend], distancemodenames[distancemode]);
+	printf("setup %.2f ms, bake %.2f ms (%.1f Mtexels/s), write %.2f ms\n",
+		(t1 - t0) * 1000.0, (t2 - t1) * 1000.0, texsize[0] * texsize[1] / (t2 - t1) * 1e-6, (t3 - t2) * 1000.0);
+	if (checkerror)
+		printf("max error %g against the boundary kernel (every %ith texel)\n", CheckError(d, texsize[0], texsize[1]), CHECK_ERROR_STRIDE);
+
+	return 0;
+}
@@ -0,0 +1,468 @@
+// times the distance kernels and the bake paths. Every benchmark is run a
+// few times to warm up and then repeated, and the time per item of each
+// repetition is reported as percentiles, along with the hardware counters
+// per item over the timed repetitions when perf events are available.
+// Results are written as json or csv so runs can be compared by script.
+
+#include "sdf.h"
+
+#define BENCH_POINTS		4096		// query points per repetition
+#define BENCH_WORK		(1 << 22)	// triangles or segments tested per repetition by the linear modes
+#define MAX_BENCH_RESULTS	128
+#define MAX_BENCH_REPS		1000
+
+enum benchformat_t
+{
+	bf_json,
+	bf_csv,
+	NUM_BENCH_FORMATS
+};
+
+static const char *benchformatnames[NUM_BENCH_FORMATS] = { "json", "csv" };
+
+typedef struct benchresult_s
+{
+	char name[64];
+	int items;			// work items per repetition
+	int reps;
+	double min, p50, p90, p99, max;	// nanoseconds per item
+	double counters[NUM_PERF_COUNTERS];	// per item, -1 when not counted
+	double ipc;			// -1 when not counted
+
+} benchresult_t;
+
+static benchresult_t results[MAX_BENCH_RESULTS];
+static int numresults;
+
+static int warmup = 2;
+static int reps = 15;
+static float maxtime = 2.0f;		// seconds per benchmark once the minimum reps are in
+static int numthreads;			// 0 picks the number of cores
+static int format = -1;			// -1 picks from the file extension
+static const char *filter;
+static const char *outname;
+static int shape = gs_polygons;		// generated meshes
+
+// ==============================================
+// meshes
+
+static unsigned int benchseed = 0x5df5eed;
+
+static float Bench_Random()
+{
+	// xorshift32
+	benchseed ^= benchseed << 13;
+	benchseed ^= benchseed >> 17;
+	benchseed ^= benchseed << 5;
+
+	return (benchseed >> 8) * (1.0f / (1 << 24));
+}
+
+// the acceleration structures are globals, so they are cleared and rebuilt
+// for each mesh. The old ones stay in the permanent arena.
+static void Bench_SetMesh(mesh_t *m)
+{
+	memset(&cooked, 0, sizeof(cooked));
+	memset(&bvh, 0, sizeof(bvh));
+	memset(&grid, 0, sizeof(grid));
+	memset(&boundary, 0, sizeof(boundary));
+
+	Distance_Init(m, max(GRID_DEFAULT_RES, (int)sqrtf((float)m->numtris)));
+}
+
+// ==============================================
+// timing
+
+static bool Bench_Wanted(const char *name)
+{
+	return !filter || strstr(name, filter);
+}
+
+static int Bench_CompareDouble(const void *a, const void *b)
+{
+	double da = *(const double*)a, db = *(const double*)b;
+
+	return (da > db) - (da < db);
+}
+
+static double Bench_Percentile(const double *sorted, int count, double p)
+{
+	return sorted[(int)(p * (count - 1) + 0.5)];
+}
+
+// runs func until reps repetitions are done, or at least 3 when maxtime has
+// passed
+static void Bench_Run(const char *name, int items, void (*func)(void *data), void *data)
+{
+	static double times[MAX_BENCH_REPS];
+	benchresult_t *r;
+	perfphase_t counted;
+	perfsample_t sample;
+	double start;
+	int count;
+
+	if (!Bench_Wanted(name))
+		return;
+	if (numresults == MAX_BENCH_RESULTS)
+		Error("too many benchmarks\n");
+
+	for (int i = 0; i < warmup; i++)
+		func(data);
+
+	// the counters run across every repetition, the timing calls add a
+	// few hundred instructions per repetition at most
+	Perf_Reset(&counted);
+	Perf_Begin(&sample);
+	start = Sys_Time();
+	for (count = 0; count < reps; count++)
+	{
+		if (count >= 3 && Sys_Time() - start > maxtime)
+			break;
+
+		double t0 = Sys_Time();
+		func(data);
+		times[count] = (Sys_Time() - t0) * 1e9 / items;
+	}
+	Perf_End(&counted, &sample);
+
+	qsort(times, count, sizeof(double), Bench_CompareDouble);
+
+	r = results + numresults++;
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->items = items;
+	r->reps = count;
+	r->min = times[0];
+	r->p50 = Bench_Percentile(times, count, 0.5);
+	r->p90 = Bench_Percentile(times, count, 0.9);
+	r->p99 = Bench_Percentile(times, count, 0.99);
+	r->max = times[count - 1];
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+		r->counters[i] = counted.counts[i] < 0 ? -1.0 : (double)counted.counts[i] / ((double)items * count);
+	r->ipc = Perf_IPC(&counted);
+
+	printf("%-32s %9i items %4i reps  p50 %10.2f ns  p90 %10.2f ns  %9.3g Mitems/s  %5.2f ipc\n", r->name,
+		r->items, r->reps, r->p50, r->p90, 1e3 / r->p50, r->ipc);
+}
+
+// ==============================================
+// benchmarks
+
+typedef struct benchpoints_s
+{
+	int numpoints;
+	float (*p)[2];
+	float sink;			// keeps the results live
+
+} benchpoints_t;
+
+static void Bench_RandomPoints(benchpoints_t *bp, int numpoints)
+{
+	bp->numpoints = numpoints;
+	bp->p = (float(*)[2])Arena_Alloc(Mem_Temp(), numpoints * sizeof(*bp->p), MEM_ALIGN);
+	bp->sink = 0.0f;
+
+	for (int i = 0; i < numpoints; i++)
+	{
+		bp->p[i][0] = WORLD_MIN + (WORLD_MAX - WORLD_MIN) * Bench_Random();
+		bp->p[i][1] = WORLD_MIN + (WORLD_MAX - WORLD_MIN) * Bench_Random();
+	}
+}
+
+static void Bench_TriangleDistance(void *data)
+{
+	benchpoints_t *bp = (benchpoints_t*)data;
+	float sum = 0.0f;
+
+	for (int i = 0; i < bp->numpoints; i++)
+	{
+		for (int j = 0; j < mesh.numtris; j++)
+			sum += TriangleDistance(bp->p[i], mesh.verts[mesh.tris[j][0]], mesh.verts[mesh.tris[j][1]], mesh.verts[mesh.tris[j][2]]);
+	}
+
+	bp->sink += sum;
+}
+
+static void Bench_Distance(void *data)
+{
+	benchpoints_t *bp = (benchpoints_t*)data;
+	float sum = 0.0f;
+
+	for (int i = 0; i < bp->numpoints; i++)
+		sum += Distance(bp->p[i]);
+
+	bp->sink += sum;
+}
+
+static void Bench_Gradient(void *data)
+{
+	benchpoints_t *bp = (benchpoints_t*)data;
+	float sum = 0.0f;
+
+	for (int i = 0; i < bp->numpoints; i++)
+	{
+		float grad[2];
+
+		Gradient(grad, bp->p[i]);
+		sum += grad[0] + grad[1];
+	}
+
+	bp->sink += sum;
+}
+
+typedef struct benchbake_s
+{
+	int texsize;
+	float sink;
+
+} benchbake_t;
+
+static void Bench_BuildTextureData(void *data)
+{
+	benchbake_t *bb = (benchbake_t*)data;
+	arena_t *temp = Mem_Temp();
+	size_t mark = Arena_Mark(temp);
+	unsigned char *rgba = BuildTextureData(temp, bb->texsize, bb->texsize);
+
+	bb->sink += rgba[(bb->texsize * bb->texsize / 2) * 4];
+	Arena_Release(temp, mark);
+}
+
+static bool Bench_QueriesWanted(const char *meshname)
+{
+	char name[64];
+
+	for (int i = 0; i < NUM_DISTANCE_MODES; i++)
+	{
+		snprintf(name, sizeof(name), "distance/%s/%s", meshname, distancemodenames[i]);
+		if (Bench_Wanted(name))
+			return true;
+		snprintf(name, sizeof(name), "gradient/%s/%s", meshname, distancemodenames[i]);
+		if (Bench_Wanted(name))
+			return true;
+	}
+
+	return false;
+}
+
+// the queries on the current mesh in every distance mode. The linear modes
+// test every triangle or segment so they get fewer points on the large
+// meshes.
+static void Bench_Queries(const char *meshname)
+{
+	char name[64];
+
+	for (int i = 0; i < NUM_DISTANCE_MODES; i++)
+	{
+		benchpoints_t bp;
+		int cost = 1;
+		arena_t *temp = Mem_Temp();
+		size_t mark = Arena_Mark(temp);
+
+		if (i == dm_brute)
+			cost = cooked.numtris;
+		else if (i == dm_boundary)
+			cost = boundary.numsegs;
+
+		distancemode = i;
+		Bench_RandomPoints(&bp, max(16, min(BENCH_POINTS, BENCH_WORK / cost)));
+
+		snprintf(name, sizeof(name), "distance/%s/%s", meshname, distancemodenames[i]);
+		Bench_Run(name, bp.numpoints, Bench_Distance, &bp);
+		snprintf(name, sizeof(name), "gradient/%s/%s", meshname, distancemodenames[i]);
+		Bench_Run(name, bp.numpoints, Bench_Gradient, &bp);
+
+		Arena_Release(temp, mark);
+	}
+}
+
+// ==============================================
+// output
+
+static void WriteJSON(FILE *fp)
+{
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"threads\": %i,\n", pool.numthreads);
+	fprintf(fp, "\t\"unit\": \"ns per item\",\n");
+	fprintf(fp, "\t\"counters\": \"per item, -1 when not counted\",\n");
+	fprintf(fp, "\t\"benchmarks\": [\n");
+	for (int i = 0; i < numresults; i++)
+	{
+		benchresult_t *r = results + i;
+
+		fprintf(fp, "\t\t{ \"name\": \"%s\", \"items\": %i, \"reps\": %i, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f",
+			r->name, r->items, r->reps, r->min, r->p50, r->p90, r->p99, r->max);
+		for (int j = 0; j < NUM_PERF_COUNTERS; j++)
+			fprintf(fp, ", \"%s\": %.4f", perfcounternames[j], r->counters[j]);
+		fprintf(fp, ", \"ipc\": %.3f }%s\n", r->ipc, i + 1 < numresults ? "," : "");
+	}
+	fprintf(fp, "\t]\n");
+	fprintf(fp, "}\n");
+}
+
+static void WriteCSV(FILE *fp)
+{
+	fprintf(fp, "name,items,reps,min_ns,p50_ns,p90_ns,p99_ns,max_ns");
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+		fprintf(fp, ",%s", perfcounternames[i]);
+	fprintf(fp, ",ipc\n");
+	for (int i = 0; i < numresults; i++)
+	{
+		benchresult_t *r = results + i;
+
+		fprintf(fp, "%s,%i,%i,%.3f,%.3f,%.3f,%.3f,%.3f", r->name, r->items, r->reps, r->min, r->p50, r->p90, r->p99, r->max);
+		for (int j = 0; j < NUM_PERF_COUNTERS; j++)
+			fprintf(fp, ",%.4f", r->counters[j]);
+		fprintf(fp, ",%.3f\n", r->ipc);
+	}
+}
+
+static void PrintUsage()
+{
+	printf("usage: sdfbench [options] [output]\n");
+	printf("  -filter <text>         only run benchmarks with text in their name\n");
+	printf("  -warmup <n>            untimed runs before timing (default %i)\n", warmup);
+	printf("  -reps <n>              timed repetitions (default %i)\n", reps);
+	printf("  -maxtime <s>           stop repeating after this long once 3 reps are done (default %g)\n", maxtime);
+	printf("  -threads <n>           bake threads, 0 for one per core (default 0)\n");
+	printf("  -shape <polygons|maze|clutter|slivers>  generated meshes to query (default %s)\n", genshapenames[shape]);
+	printf("  -format <json|csv>     output format (default from the extension, else json)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const int meshsizes[] = { 1000, 100000, 1000000 };
+	static const int texsizes[] = { 256, 1024, 4096 };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-filter") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "-warmup") && i + 1 < argc)
+			warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-reps") && i + 1 < argc)
+			reps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-maxtime") && i + 1 < argc)
+			maxtime = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			numthreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-shape") && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+
+			for (shape = 0; shape < NUM_GEN_SHAPES; shape++)
+			{
+				if (!strcmp(name, genshapenames[shape]))
+					break;
+			}
+			if (shape == NUM_GEN_SHAPES)
+				Error("unknown shape \"%s\"\n", name);
+		}
+		else if (!strcmp(argv[i], "-format") && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+
+			for (format = 0; format < NUM_BENCH_FORMATS; format++)
+			{
+				if (!strcmp(name, benchformatnames[format]))
+					break;
+			}
+			if (format == NUM_BENCH_FORMATS)
+				Error("unknown format \"%s\"\n", name);
+		}
+		else if (argv[i][0] != '-' && !outname)
+			outname = argv[i];
+		else
+		{
+			PrintUsage();
+			return (strcmp(argv[i], "-help") ? 1 : 0);
+		}
+	}
+
+	// min and max evaluate their arguments twice so clamp after parsing
+	warmup = max(0, warmup);
+	reps = max(1, min(reps, MAX_BENCH_REPS));
+
+	if (format < 0)
+	{
+		const char *ext = outname ? strrchr(outname, '.') : NULL;
+
+		format = (ext && !strcmp(ext, ".csv")) ? bf_csv : bf_json;
+	}
+
+	Threads_Init(numthreads);
+	Perf_Init();
+
+	// the built in outline, 57 triangles
+	Mesh_Default(&mesh);
+	Bench_SetMesh(&mesh);
+	if (Bench_Wanted("triangle"))
+	{
+		arena_t *temp = Mem_Temp();
+		size_t mark = Arena_Mark(temp);
+		benchpoints_t bp;
+
+		Bench_RandomPoints(&bp, BENCH_POINTS / 16);
+		Bench_Run("triangle", bp.numpoints * mesh.numtris, Bench_TriangleDistance, &bp);
+		Arena_Release(temp, mark);
+	}
+	Bench_Queries("outline");
+
+	for (int i = 0; i < (int)(sizeof(texsizes) / sizeof(texsizes[0])); i++)
+	{
+		for (int j = 0; j < NUM_BAKE_BACKENDS; j++)
+		{
+			// the exact backend bakes in every distance mode, the sweep
+			// makes no distance queries and bakes once
+			for (int k = 0; k < (j == bb_exact ? NUM_DISTANCE_MODES : 1); k++)
+			{
+				char name[64];
+				benchbake_t bb;
+
+				if (j == bb_exact)
+					snprintf(name, sizeof(name), "bake/%s/%s/%i", bakebackendnames[j], distancemodenames[k], texsizes[i]);
+				else
+					snprintf(name, sizeof(name), "bake/%s/%i", bakebackendnames[j], texsizes[i]);
+				if (!Bench_Wanted(name))
+					continue;
+
+				distancemode = k;
+				bakebackend = j;
+				bb.texsize = texsizes[i];
+				bb.sink = 0.0f;
+				Bench_Run(name, bb.texsize * bb.texsize, Bench_BuildTextureData, &bb);
+			}
+		}
+	}
+
+	for (int i = 0; i < (int)(sizeof(meshsizes) / sizeof(meshsizes[0])); i++)
+	{
+		char meshname[32];
+		mesh_t m;
+
+		snprintf(meshname, sizeof(meshname), "%s%i", genshapenames[shape], meshsizes[i]);
+		if (!Bench_QueriesWanted(meshname))
+			continue;
+
+		Gen_Mesh(&m, shape, meshsizes[i], 1);
+		Bench_SetMesh(&m);
+		Bench_Queries(meshname);
+	}
+
+	if (outname)
+	{
+		FILE *fp = fopen(outname, "w");
+		if (!fp)
+			Error("unable to open \"%s\" for writing\n", outname);
+
+		if (format == bf_csv)
+			WriteCSV(fp);
+		else
+			WriteJSON(fp);
+
+		if (ferror(fp) | fclose(fp))
+			Error("write to \"%s\" failed\n", outname);
+		printf("%i results written to %s as %s\n", numresults, outname, benchformatnames[format]);
+	}
+
+	return 0;
+}
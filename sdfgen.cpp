@@ -0,0 +1,92 @@
+// writes a generated mesh file for scaling tests. The files load with -mesh
+// in sdfield6, sdfbake and sdfkernels.
+
+#include "sdf.h"
+
+static int shape = gs_polygons;
+static int count = 10000;
+static unsigned int seed = 1;
+static bool accel;
+static int gridres;			// 0 scales with the triangle count
+static int numthreads;			// 0 picks the number of cores
+static const char *outname;
+
+static void PrintUsage()
+{
+	printf("usage: sdfgen [options] <output>\n");
+	printf("  -shape <polygons|maze|clutter|slivers>  what to generate (default %s)\n", genshapenames[shape]);
+	printf("  -count <n>             triangles, up to %i (default %i)\n", GEN_MAX_TRIS, count);
+	printf("  -seed <n>              random seed (default %u)\n", seed);
+	printf("  -accel                 build the acceleration structures into the file\n");
+	printf("  -gridres <n>           uniform grid cells along the longest mesh axis with -accel (default sqrt of the count, at least %i)\n", GRID_DEFAULT_RES);
+	printf("  -threads <n>           worker threads, 0 for one per core (default 0)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	mesh_t m;
+	double t0, t1, t2;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-shape") && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+
+			for (shape = 0; shape < NUM_GEN_SHAPES; shape++)
+			{
+				if (!strcmp(name, genshapenames[shape]))
+					break;
+			}
+			if (shape == NUM_GEN_SHAPES)
+				Error("unknown shape \"%s\"\n", name);
+		}
+		else if (!strcmp(argv[i], "-count") && i + 1 < argc)
+			count = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-accel"))
+			accel = true;
+		else if (!strcmp(argv[i], "-gridres") && i + 1 < argc)
+			gridres = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			numthreads = atoi(argv[++i]);
+		else if (argv[i][0] != '-' && !outname)
+			outname = argv[i];
+		else
+		{
+			PrintUsage();
+			return (strcmp(argv[i], "-help") ? 1 : 0);
+		}
+	}
+
+	// min and max evaluate their arguments twice so clamp after parsing
+	count = max(1, count);
+	count = min(count, GEN_MAX_TRIS);
+	gridres = max(0, gridres);
+
+	if (!outname)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	t0 = Sys_Time();
+	Gen_Mesh(&m, shape, count, seed);
+
+	t1 = Sys_Time();
+	if (accel)
+	{
+		Threads_Init(numthreads);
+		if (!gridres)
+			gridres = max(GRID_DEFAULT_RES, (int)sqrtf((float)m.numtris));
+		Distance_Init(&m, gridres);
+	}
+	Mesh_Write(&m, outname, accel);
+	t2 = Sys_Time();
+
+	printf("%s: %s, %i vertices, %i triangles, seed %u\n", outname, genshapenames[shape], m.numverts, m.numtris, seed);
+	printf("generate %.2f ms, %s %.2f ms\n", (t1 - t0) * 1000.0, accel ? "build and write" : "write", (t2 - t1) * 1000.0);
+
+	return 0;
+}
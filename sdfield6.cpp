@@ -1,8 +1,4 @@
-#include <stdarg.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <math.h>
-#include "triangles.h"
+#include "sdf.h"
 
 #ifdef WIN32
 #include "freeglut/include/GL/freeglut.h"
@@ -44,267 +40,358 @@ static bool keyactions[NUM_KEY_ACTIONS];
 float objx, objy;
 float movex, movey;
 
+// command line options
+static int gridres;			// 0 keeps the grid from the mesh file
+static int fieldres = FIELD_DEFAULT_RES;
+static float adftolerance = ADF_DEFAULT_TOLERANCE;
+static int numthreads;			// 0 picks the number of cores
+static const char *meshname;		// NULL for the built in outline
+static const char *tracename;		// NULL when not tracing
+
+// Called every frame to process the current mouse input state
+// We only get updates when the mouse moves so the current mouse
+// position is stored and may be used for mulitple frames
+static void ProcessInput()
+{
+	TRACE_ZONE("ProcessInput");
+	// mousepos has current "frame" mouse pos
+	input.moused[0] = mousepos[0] - input.mousepos[0];
+	input.moused[1] = mousepos[1] - input.mousepos[1];
+	input.mousepos[0] = mousepos[0];
+	input.mousepos[1] = mousepos[1];
+}
+
 // ==============================================
-// memory allocation
+// gameplay queries
+//
+// the player and thing movement go through these so the exact mesh query,
+// the baked field and the adaptive field can be swapped at runtime ('f').
+// Game_Distance and Game_DistanceGradient below also feed the runtime stats.
 
-void *Mem_Alloc(int numbytes)
+enum gamequery_t
 {
-	#define MEM_ALLOC_SIZE	16 * 1024 * 1024
+	gq_exact,
+	gq_field,
+	gq_adf,
+	NUM_GAME_QUERIES
+};
 
-	typedef struct memstack_s
-	{
-		unsigned char mem[MEM_ALLOC_SIZE];
-		int allocated;
+static const char *gamequerynames[NUM_GAME_QUERIES] = { "exact", "baked field", "adaptive field" };
+static int gamequery = gq_exact;
 
-	} memstack_t;
+// the exact gradient has unit length but the interpolated ones do not and
+// can vanish, so those are normalized here and a zero gradient takes the
+// direction of the exact one
+static float Game_Query(float p[2], float grad[2])
+{
+	bool sampled = false;
+	float d;
+
+	if (gamequery == gq_field)
+		sampled = Field_Sample(&field, p, &d, grad);
+	else if (gamequery == gq_adf)
+		sampled = ADF_Sample(&adf, p, &d, grad);
+
+	if (!sampled)
+		return (grad ? DistanceGradient(grad, p) : Distance(p));
 
-	static memstack_t memstack;
-	unsigned char *mem;
-	
-	if(memstack.allocated + numbytes > MEM_ALLOC_SIZE)
+	if (grad)
 	{
-		printf("Error: Mem: no free space available\n");
-		abort();
+		if (Vec2_Length(grad) > 0.0f)
+			Vec2_Normalize(grad);
+		else
+			DistanceGradient(grad, p);
 	}
 
-	mem = memstack.mem + memstack.allocated;
-	memstack.allocated += numbytes;
+	return d;
+}
 
-	return mem;
+static void Game_CycleQuery()
+{
+	gamequery = (gamequery + 1) % NUM_GAME_QUERIES;
+	printf("gameplay queries: %s\n", gamequerynames[gamequery]);
 }
 
 // ==============================================
-// errors and warnings
+// runtime stats
+//
+// with -stats <file> the gameplay queries are measured every tick: the
+// Game_Distance and Game_DistanceGradient calls, the triangles each query
+// tested, the time between ticks and how many tries TryMove took. Every
+// interval a summary is appended to the file as one line of json, along
+// with where the player was on the tick that tested the most triangles, to
+// find the spots that blow the per tick query budget.
+//
+// The hardware counters are summed per phase: the bakes made on the render
+// thread, and the distance and gradient queries. Background bakes are not
+// counted, and while one runs its pool workers count towards whichever
+// render thread phase is open.
+
+#define STATS_DEFAULT_INTERVAL	5.0f
+#define STATS_MAX_SAMPLES	8192		// per value and interval, the percentiles skip any after these
+#define TRYMOVE_MAX_TRIES	5
+
+enum statvalue_t
+{
+	sv_frametime,
+	sv_distancecalls,
+	sv_gradientcalls,
+	sv_frametests,
+	sv_querytests,
+	NUM_STAT_VALUES
+};
+
+static const char *statvaluenames[NUM_STAT_VALUES] = { "frame_ms", "distance_calls", "gradient_calls", "tests_per_frame", "tests_per_query" };
 
-static void Error(const char *error, ...)
+enum statphase_t
 {
-	va_list valist;
-	char buffer[2048];
+	sp_bake,
+	sp_distance,
+	sp_gradient,
+	NUM_STAT_PHASES
+};
 
-	va_start(valist, error);
-	vsprintf(buffer, error, valist);
-	va_end(valist);
+static const char *statphasenames[NUM_STAT_PHASES] = { "bake", "distance", "gradient" };
 
-	printf("Error: %s", buffer);
-	exit(1);
-}
+typedef struct statsamples_s
+{
+	int count;
+	double sum;
+	float max;
+	int numsamples;
+	float samples[STATS_MAX_SAMPLES];
 
-static void Warning(const char *warning, ...)
+} statsamples_t;
+
+typedef struct stats_s
 {
-	va_list valist;
-	char buffer[2048];
+	FILE *fp;
+	double start;			// start of the interval
+	double lasttick;
+	int frames;
 
-	va_start(valist, warning);
-	vsprintf(buffer, warning, valist);
-	va_end(valist);
+	// this tick
+	int distancecalls, gradientcalls;
+	unsigned int frametests;
 
-	fprintf(stdout, "Warning: %s", buffer);
-}
+	statsamples_t values[NUM_STAT_VALUES];
+	int trymoves[TRYMOVE_MAX_TRIES + 1];	// moves made after 1 to TRYMOVE_MAX_TRIES tries
+	int trymovesblocked;		// the slide turned back against the move
+	int trymovesfailed;		// no good move in TRYMOVE_MAX_TRIES tries
 
-// ==============================================
-// vector utils
+	unsigned int worsttests;
+	float worstpos[2];
 
-static void Vec2_Copy(float a[2], float b[2])
-{
-	a[0] = b[0];
-	a[1] = b[1];
-}
+	perfphase_t phases[NUM_STAT_PHASES];
 
-static void Vec2_Normalize(float *v)
-{
-	float len, invlen;
+} stats_t;
+
+static const char *statsname;		// NULL when not gathering stats
+static float statsinterval = STATS_DEFAULT_INTERVAL;
+static stats_t stats;
 
-	len = sqrtf((v[0] * v[0]) + (v[1] * v[1]));
-	invlen = 1.0f / len;
+static void Stats_Sample(int value, float x)
+{
+	statsamples_t *s = stats.values + value;
 
-	v[0] *= invlen;
-	v[1] *= invlen;
+	if (s->numsamples < STATS_MAX_SAMPLES)
+		s->samples[s->numsamples++] = x;
+	s->count++;
+	s->sum += x;
+	s->max = max(s->max, x);
 }
 
-// return the circular distance
-static float Vec2_Length(float v[2])
+static int Stats_CompareFloat(const void *a, const void *b)
 {
-	return sqrtf((v[0] * v[0]) + (v[1] * v[1]));
+	float fa = *(const float*)a, fb = *(const float*)b;
+
+	return (fa > fb) - (fa < fb);
 }
 
-static float Vec2_Dot(float a[2], float b[2])
+static float Stats_Percentile(const float *sorted, int count, float p)
 {
-	return (a[0] * b[0]) + (a[1] * b[1]);
+	return sorted[(int)(p * (count - 1) + 0.5f)];
 }
 
-static void Plane2d(float abc[3], float a[2], float b[2])
+// appends the interval as a line of json and starts the next one
+static void Stats_Write(double now)
 {
-	float x0, y0, x1, y1, x, y, l, nx, ny, d;
+	fprintf(stats.fp, "{\"time\":%.3f,\"seconds\":%.3f,\"frames\":%i,\"distancemode\":\"%s\",\"gamequery\":\"%s\"",
+		now, now - stats.start, stats.frames, distancemodenames[distancemode], gamequerynames[gamequery]);
 
-	x0 = a[0], y0 = a[1];
-	x1 = b[0], y1 = b[1];
+	for (int i = 0; i < NUM_STAT_VALUES; i++)
+	{
+		statsamples_t *s = stats.values + i;
 
-	x = x1 - x0;
-	y = y1 - y0;
-	l = sqrt((x * x) + (y * y));
+		fprintf(stats.fp, ",\"%s\":", statvaluenames[i]);
+		if (!s->numsamples)
+		{
+			fprintf(stats.fp, "null");
+			continue;
+		}
 
-	nx =  y / l;
-	ny = -x / l;
-	d = -x0 * nx - y0 * ny;
+		qsort(s->samples, s->numsamples, sizeof(float), Stats_CompareFloat);
+		fprintf(stats.fp, "{\"count\":%i,\"mean\":%.4g,\"p50\":%.4g,\"p90\":%.4g,\"p99\":%.4g,\"max\":%.4g}",
+			s->count, s->sum / s->count, Stats_Percentile(s->samples, s->numsamples, 0.5f),
+			Stats_Percentile(s->samples, s->numsamples, 0.9f), Stats_Percentile(s->samples, s->numsamples, 0.99f), s->max);
+	}
 
-	abc[0] = nx, abc[1] = ny, abc[2] = d;
-}
+	fprintf(stats.fp, ",\"trymove_tries\":[");
+	for (int i = 1; i <= TRYMOVE_MAX_TRIES; i++)
+		fprintf(stats.fp, "%s%i", i > 1 ? "," : "", stats.trymoves[i]);
+	fprintf(stats.fp, "],\"trymove_blocked\":%i,\"trymove_failed\":%i", stats.trymovesblocked, stats.trymovesfailed);
+	fprintf(stats.fp, ",\"worst_frame\":{\"tests\":%u,\"pos\":[%.3f,%.3f]}", stats.worsttests, stats.worstpos[0], stats.worstpos[1]);
 
-static float PlaneDistance(float abc[3], float xy[2])
-{
-	float a, b, c, x, y;
+	// -1 when not counted
+	fprintf(stats.fp, ",\"perf\":{");
+	for (int i = 0; i < NUM_STAT_PHASES; i++)
+	{
+		perfphase_t *p = stats.phases + i;
 
-	a = abc[0], b = abc[1], c = abc[2];
-	x = xy[0], y = xy[1];
-	return (a * x) + (b * y) + c;
+		fprintf(stats.fp, "%s\"%s\":{\"calls\":%i", i ? "," : "", statphasenames[i], p->calls);
+		for (int j = 0; j < NUM_PERF_COUNTERS; j++)
+			fprintf(stats.fp, ",\"%s\":%lli", perfcounternames[j], p->counts[j]);
+		fprintf(stats.fp, ",\"ipc\":%.3f}", Perf_IPC(p));
+		Perf_Reset(p);
+	}
+	fprintf(stats.fp, "}}\n");
+	fflush(stats.fp);
+
+	// keeps the file and the tick in progress
+	memset(stats.values, 0, sizeof(stats.values));
+	memset(stats.trymoves, 0, sizeof(stats.trymoves));
+	stats.trymovesblocked = 0;
+	stats.trymovesfailed = 0;
+	stats.worsttests = 0;
+	stats.frames = 0;
+	stats.start = now;
 }
 
-// Called every frame to process the current mouse input state
-// We only get updates when the mouse moves so the current mouse
-// position is stored and may be used for mulitple frames
-static void ProcessInput()
+static void Stats_Open()
 {
-	// mousepos has current "frame" mouse pos
-	input.moused[0] = mousepos[0] - input.mousepos[0];
-	input.moused[1] = mousepos[1] - input.mousepos[1];
-	input.mousepos[0] = mousepos[0];
-	input.mousepos[1] = mousepos[1];
-}
+	stats.fp = fopen(statsname, "w");
+	if (!stats.fp)
+		Error("Stats: unable to open \"%s\" for writing\n", statsname);
 
-static float CircleDistance(float p[2], float r)
-{
-	return Vec2_Length(p) - r;
+	Perf_Init();
+	stats.start = Sys_Time();
 }
 
-#undef min
-#define min(a, b) (a < b ? a : b)
-
-#undef max
-#define max(a, b) (a > b ? a : b)
-
-static float BoxDistance(float p[2])
+// for atexit, writes the interval in progress
+static void Stats_Close()
 {
-	float d[2];
-	float b[2] = { 1, 0.2 };
+	if (!stats.fp)
+		return;
 
-	d[0] = fabs(p[0]) - b[0];
-	d[1] = fabs(p[1]) - b[1];
-
-	float d2[2] = { max(d[0], 0.0f), max(d[1], 0.0f) };
-	return min(max(d[0], d[1]), 0.0f) + Vec2_Length(d2);
+	if (stats.frames)
+		Stats_Write(Sys_Time());
+	fclose(stats.fp);
+	stats.fp = NULL;
 }
 
-static float TriangleDistance(float p[2], float v0[2], float v1[2], float v2[2])
+// called at the start of every tick, closes the previous one
+static void Stats_Tick()
 {
-	float abc0[3], abc1[3], abc2[3];
-	float n00[2], n01[2], n10[2], n11[2], n20[2], n21[2];
-
-	float v0p[2], v1p[2], v2p[2];
+	double now;
 
-	Plane2d(abc0, v0, v1);
-	Plane2d(abc1, v1, v2);
-	Plane2d(abc2, v2, v0);
+	if (!stats.fp)
+		return;
 
-	// calculate positive and negative skewed normals
-	n00[0] = -abc2[1], n00[1] =  abc2[0];
-	n01[0] =  abc0[1], n01[1] = -abc0[0];
-	n10[0] = -abc0[1], n10[1] =  abc0[0];
-	n11[0] =  abc1[1], n11[1] = -abc1[0];
-	n20[0] = -abc1[1], n20[1] =  abc1[0];
-	n21[0] =  abc2[1], n21[1] = -abc2[0];
-
-	v0p[0] = p[0] - v0[0], v0p[1] = p[1] - v0[1];
-	v1p[0] = p[0] - v1[0], v1p[1] = p[1] - v1[1];
-	v2p[0] = p[0] - v2[0], v2p[1] = p[1] - v2[1];
-
-	if (Vec2_Dot(n00, v0p) > 0.0f && Vec2_Dot(n01, v0p) > 0.0f)
-		return Vec2_Length(v0p);
-	if (Vec2_Dot(n10, v1p) > 0.0f && Vec2_Dot(n11, v1p) > 0.0f)
-		return Vec2_Length(v1p);
-	if (Vec2_Dot(n20, v2p) > 0.0f && Vec2_Dot(n21, v2p) > 0.0f)
-		return Vec2_Length(v2p);
+	now = Sys_Time();
+	if (stats.lasttick > 0.0)
+	{
+		Stats_Sample(sv_frametime, (float)((now - stats.lasttick) * 1000.0));
+		Stats_Sample(sv_distancecalls, (float)stats.distancecalls);
+		Stats_Sample(sv_gradientcalls, (float)stats.gradientcalls);
+		Stats_Sample(sv_frametests, (float)stats.frametests);
+		if (stats.frametests >= stats.worsttests)
+		{
+			stats.worsttests = stats.frametests;
+			stats.worstpos[0] = objx;
+			stats.worstpos[1] = objy;
+		}
+		stats.frames++;
+	}
 
-	float f0 = PlaneDistance(abc0, p);
-	float f1 = PlaneDistance(abc1, p);
-	float f2 = PlaneDistance(abc2, p);
+	stats.lasttick = now;
+	stats.distancecalls = 0;
+	stats.gradientcalls = 0;
+	stats.frametests = 0;
 
-	return max(f0, max(f1, f2));
+	if (now - stats.start >= statsinterval)
+		Stats_Write(now);
 }
 
-
-static float Distance(float p[2])
+static void Stats_PhaseBegin(perfsample_t *s)
 {
-	float d;
-	for (int i = 0; i < 171; i += 3)
-	{
-		float v0[2], v1[2], v2[2];
-		float s = 1.0f;
-		v0[0] = vertices[i + 0][0] * s;
-		v0[1] = vertices[i + 0][1] * s;
-		v1[0] = vertices[i + 1][0] * s;
-		v1[1] = vertices[i + 1][1] * s;
-		v2[0] = vertices[i + 2][0] * s;
-		v2[1] = vertices[i + 2][1] * s;
-
-		float q = TriangleDistance(p, v0, v1, v2);
-
-		if (i == 0)
-			d = q;
-		else
-			d = min(d, q);
-	}
-
-	return d;
+	if (stats.fp)
+		Perf_Begin(s);
 }
 
-#if 0
-static float Distance(float p[2], float r)
+static void Stats_PhaseEnd(int phase, const perfsample_t *s)
 {
-	return CircleDistance(p, r);
+	if (stats.fp)
+		Perf_End(stats.phases + phase, s);
 }
-#endif
 
-#if 0
-static float Distance(float p[2], float r)
+// tries is 0 when TryMove gave up
+static void Stats_TryMove(int tries, bool blocked)
 {
-	float d0, d1;
+	if (!stats.fp)
+		return;
+
+	if (blocked)
+		stats.trymovesblocked++;
+	else if (!tries)
+		stats.trymovesfailed++;
+	else
+		stats.trymoves[tries]++;
+}
 
-	float p0[2] = { p[0], p[1] };
-	d0 = CircleDistance(p0, r);
+// the sampled fields test no triangles unless p is outside them
+static float Game_Distance(float p[2])
+{
+	unsigned int tests = distancetests;
+	perfsample_t sample;
+	float d;
 
-	float p1[2] = { p[0] - 1, p[1] };
-	d1 = CircleDistance(p1, r);
+	Stats_PhaseBegin(&sample);
+	d = Game_Query(p, NULL);
+	Stats_PhaseEnd(sp_distance, &sample);
 
-	return (d0 < d1 ? d0 : d1);
-}
-#endif
+	if (stats.fp)
+	{
+		stats.distancecalls++;
+		stats.frametests += distancetests - tests;
+		Stats_Sample(sv_querytests, (float)(distancetests - tests));
+	}
 
-#if 0
-static float Distance(float p[2], float r)
-{
-	return BoxDistance(p);
+	return d;
 }
-#endif
 
-static void Gradient(float grad[2], float p[2])
+static float Game_DistanceGradient(float grad[2], float p[2])
 {
-	float h = 0.01f;
-	float dx, dy;
+	unsigned int tests = distancetests;
+	perfsample_t sample;
+	float d;
 
-	float p0[2] = { p[0] - h, p[1] };
-	float p1[2] = { p[0] + h, p[1] };
-	dx = (Distance(p1) - Distance(p0)) / (2 * h);
+	Stats_PhaseBegin(&sample);
+	d = Game_Query(p, grad);
+	Stats_PhaseEnd(sp_gradient, &sample);
 
-	float p2[2] = { p[0], p[1] - h };
-	float p3[2] = { p[0], p[1] + h };
-	dy = (Distance(p3) - Distance(p2)) / (2 * h);
+	if (stats.fp)
+	{
+		stats.gradientcalls++;
+		stats.frametests += distancetests - tests;
+		Stats_Sample(sv_querytests, (float)(distancetests - tests));
+	}
 
-	grad[0] = dx;
-	grad[1] = dy;
+	return d;
 }
 
 static void DrawCursor()
 {
+	TRACE_ZONE("DrawCursor");
 	float xy[2], d, grad[2];
 
 	// convert mouse position from screen to identity
@@ -317,10 +404,9 @@ static void DrawCursor()
 
 	fprintf(stdout, "x, y: %2.2f, %2.2f\n", xy[0], xy[1]);
 
-	d = Distance(xy);
+	d = DistanceGradient(grad, xy);
 	fprintf(stdout, "distance %f\n", d);
 
-	Gradient(grad, xy);
 	Vec2_Normalize(grad);
 	fprintf(stdout, "gradient %f, %f\n", grad[0], grad[1]);
 
@@ -333,46 +419,381 @@ static void DrawCursor()
 	glEnd();
 }
 
-static unsigned char *BuildTextureData(int texw, int texh)
+// ==============================================
+// progressive bake
+//
+// instead of stalling on a full bake, a resize first bakes a field at
+// 1 / BAKE_COARSE_SCALE resolution and scales it up so something is
+// drawn immediately. Each frame then re-bakes blocks of rows at full
+// resolution until the frame budget is spent, and only those rows are
+// uploaded. Refinement uses the exact backend; the sweep backend is fast
+// enough to always bake in one go.
+
+enum bakemode_t
+{
+	bm_sync,
+	bm_progressive,
+	bm_background,
+	NUM_BAKE_MODES
+};
+
+static const char *bakemodenames[NUM_BAKE_MODES] = { "sync", "progressive", "background" };
+static int bakemode = bm_progressive;
+static bool bakedirty;
+
+#define BAKE_COARSE_SCALE	8
+#define BAKE_DEFAULT_BUDGET	4.0f		// milliseconds out of the 16 ms tick
+
+static float bakebudget = BAKE_DEFAULT_BUDGET;
+
+typedef struct progressive_s
+{
+	int texw, texh;
+	unsigned char *data;		// full resolution rgba, refined in place
+	int row;			// next row to refine, texh when complete
+	double rowtime;			// measured seconds per row
+
+} progressive_t;
+
+static progressive_t progressive;
+
+typedef struct bakerows_s
+{
+	unsigned char *data;
+	int texw, texh;
+	int first;
+
+} bakerows_t;
+
+static void Bake_RowJob(int job, int thread, void *data)
+{
+	bakerows_t *br = (bakerows_t*)data;
+	int y = br->first + job;
+	float xy[BAKE_TILE_SIZE][2], d[BAKE_TILE_SIZE];
+
+	for (int x0 = 0; x0 < br->texw; x0 += BAKE_TILE_SIZE)
+	{
+		int count = min(BAKE_TILE_SIZE, br->texw - x0);
+
+		for (int x = 0; x < count; x++)
+			Bake_TexelToWorld(br->texw, br->texh, (float)(x0 + x), (float)y, xy[x]);
+
+		Distance_Batch(xy, d, count);
+		ColorizeField(br->data + (y * br->texw + x0) * 4, d, count);
+	}
+}
+
+// bakes the coarse field into the full resolution buffer
+static void Progressive_Begin(progressive_t *pg, int texw, int texh)
 {
-	unsigned char *data = (unsigned char*)malloc(texw * texh * 4);
+	TRACE_ZONE("Progressive_Begin");
+	int cw, ch;
+	float *coarse;
+	unsigned char *rgba;
+
+	pg->texw = texw;
+	pg->texh = texh;
+	pg->data = (unsigned char*)realloc(pg->data, texw * texh * 4);
+	pg->row = 0;
+	pg->rowtime = 0.0;
+
+	cw = max(1, texw / BAKE_COARSE_SCALE);
+	ch = max(1, texh / BAKE_COARSE_SCALE);
+	coarse = BuildFieldData(Mem_Frame(), cw, ch);
+	rgba = (unsigned char*)Arena_Alloc(Mem_Frame(), cw * ch * 4, MEM_ALIGN);
+	ColorizeField(rgba, coarse, cw * ch);
+
 	for (int y = 0; y < texh; y++)
 	{
+		const unsigned char *src = rgba + (min(y * ch / texh, ch - 1) * cw) * 4;
+		unsigned char *dst = pg->data + (y * texw) * 4;
+
 		for (int x = 0; x < texw; x++)
+			memcpy(dst + x * 4, src + min(x * cw / texw, cw - 1) * 4, 4);
+	}
+}
+
+// refines rows until the budget runs out, returns the first refined row and
+// the number of rows through count. The block size comes from the measured
+// time per row so a frame does not overrun by more than about one row.
+static int Progressive_Step(progressive_t *pg, float budgetms, int *count)
+{
+	TRACE_ZONE("Progressive_Step");
+	double start, budget;
+	int first = pg->row;
+
+	start = Sys_Time();
+	budget = budgetms * 0.001;
+	while (pg->row < pg->texh)
+	{
+		double blockstart = Sys_Time();
+		int rows;
+
+		if (pg->rowtime > 0.0)
 		{
-			float xy[2];
-
-			// convert mouse position from screen to identity
-			xy[0] = (float)x / (float)texw;
-			//xy[1] = 1.0f - ((float)y / (float)renderheight);
-			xy[1] = (float)y / (float)texh;
-
-			// convert from identity to model pos
-			xy[0] = -6 + xy[0] * 12;
-			xy[1] = -6 + xy[1] * 12;
-
-			float d = Distance(xy);
-			d = max(-1.0f, min(d, 1.0f));
-			d *= 50;
-			
-			unsigned char *t = data + (y * texw * 4) + (x * 4);
-			*t++ = max(0, d) + 50;
-			*t++ = 0;
-			*t++ = max(0, -d) + 50;
-			*t++ = 255;
+			rows = (int)((budget - (blockstart - start)) / pg->rowtime);
+			if (rows < 1 && pg->row != first)
+				break;
+			rows = min(max(rows, 1), pg->texh - pg->row);
 		}
+		else
+			rows = 1;
+
+		bakerows_t br;
+		br.data = pg->data;
+		br.texw = pg->texw;
+		br.texh = pg->texh;
+		br.first = pg->row;
+
+		Threads_Run(rows, Bake_RowJob, &br);
+		pg->row += rows;
+		pg->rowtime = (Sys_Time() - blockstart) / rows;
 	}
 
-	return data;
+	*count = pg->row - first;
+	return first;
+}
+
+// ==============================================
+// background bake
+//
+// a dedicated thread bakes the next texture into a back buffer while the
+// render thread keeps drawing the previous texture. When the bake finishes
+// the render thread uploads the back buffer and the two buffers swap
+// roles. A new request, such as another resize while the window edge is
+// being dragged, cancels the bake in flight: remaining tiles are skipped
+// and the partial result is thrown away. The sweep backend is not split
+// into tiles, so its bakes run to completion before being dropped. The
+// backend and distance mode are taken with the request, as the keys can
+// change them during a bake.
+
+typedef struct backgroundbake_s
+{
+	bool started;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+
+	// written by the render thread under lock
+	int request;			// bumped for every new bake, also read atomically without the lock
+	int reqw, reqh;
+	int reqbackend, reqmode;
+
+	unsigned char *buffers[2];
+	int front;			// buffer last uploaded by the render thread
+	int ready;			// finished back buffer, -1 when none
+	int readyw, readyh;
+
+} backgroundbake_t;
+
+static backgroundbake_t background;
+
+typedef struct bakecolortiles_s
+{
+	unsigned char *data;
+	int texw, texh;
+	int tilesx;
+	int mode;
+	int request;			// bake is cancelled once this is stale
+
+} bakecolortiles_t;
+
+static bool Background_Cancelled(int request)
+{
+	return __atomic_load_n(&background.request, __ATOMIC_RELAXED) != request;
+}
+
+static void Background_TileJob(int tile, int thread, void *data)
+{
+	bakecolortiles_t *bt = (bakecolortiles_t*)data;
+	float xy[BAKE_TILE_SIZE][2], d[BAKE_TILE_SIZE];
+	int x0, y0, x1, y1;
+
+	if (Background_Cancelled(bt->request))
+		return;
+
+	x0 = (tile % bt->tilesx) * BAKE_TILE_SIZE;
+	y0 = (tile / bt->tilesx) * BAKE_TILE_SIZE;
+	x1 = min(x0 + BAKE_TILE_SIZE, bt->texw);
+	y1 = min(y0 + BAKE_TILE_SIZE, bt->texh);
+
+	for (int y = y0; y < y1; y++)
+	{
+		for (int x = x0; x < x1; x++)
+			Bake_TexelToWorld(bt->texw, bt->texh, (float)x, (float)y, xy[x - x0]);
+
+		Distance_BatchMode(bt->mode, xy, d, x1 - x0);
+		ColorizeField(bt->data + (y * bt->texw + x0) * 4, d, x1 - x0);
+	}
+}
+
+static void *Background_Main(void *arg)
+{
+	backgroundbake_t *bg = (backgroundbake_t*)arg;
+	int done = 0;
+
+	Trace_ThreadName("background bake");
+	while (1)
+	{
+		int request, texw, texh, backend, mode, back;
+
+		pthread_mutex_lock(&bg->lock);
+		while (bg->request == done)
+			pthread_cond_wait(&bg->wake, &bg->lock);
+		request = bg->request;
+		texw = bg->reqw;
+		texh = bg->reqh;
+		backend = bg->reqbackend;
+		mode = bg->reqmode;
+
+		// the buffer that is not on screen, dropping any unclaimed result
+		back = 1 - bg->front;
+		bg->ready = -1;
+		bg->buffers[back] = (unsigned char*)realloc(bg->buffers[back], texw * texh * 4);
+		pthread_mutex_unlock(&bg->lock);
+
+		TRACE_ZONE("Background_Bake");
+		double start = Sys_Time();
+		if (backend == bb_sweep)
+		{
+			arena_t *temp = Mem_Temp();
+			size_t mark = Arena_Mark(temp);
+			float *d = (float*)Arena_Alloc(temp, texw * texh * sizeof(float), COOKED_ALIGN);
+			Bake_Sweep(d, texw, texh);
+			ColorizeField(bg->buffers[back], d, texw * texh);
+			Arena_Release(temp, mark);
+		}
+		else
+		{
+			bakecolortiles_t bt;
+
+			bt.data = bg->buffers[back];
+			bt.texw = texw;
+			bt.texh = texh;
+			bt.tilesx = (texw + BAKE_TILE_SIZE - 1) / BAKE_TILE_SIZE;
+			bt.mode = mode;
+			bt.request = request;
+			Threads_Run(bt.tilesx * ((texh + BAKE_TILE_SIZE - 1) / BAKE_TILE_SIZE), Background_TileJob, &bt);
+		}
+
+		pthread_mutex_lock(&bg->lock);
+		done = request;
+		if (bg->request == request)
+		{
+			bg->ready = back;
+			bg->readyw = texw;
+			bg->readyh = texh;
+			printf("background bake %i, %i done in %.1f ms\n", texw, texh, (Sys_Time() - start) * 1000.0);
+		}
+		else
+			printf("background bake %i, %i cancelled\n", texw, texh);
+		pthread_mutex_unlock(&bg->lock);
+	}
+
+	return NULL;
+}
+
+static void Background_Request(backgroundbake_t *bg, int texw, int texh)
+{
+	if (!bg->started)
+	{
+		pthread_mutex_init(&bg->lock, NULL);
+		pthread_cond_init(&bg->wake, NULL);
+		bg->ready = -1;
+		if (pthread_create(&bg->thread, NULL, Background_Main, bg))
+			Error("Background: unable to create bake thread\n");
+		bg->started = true;
+	}
+
+	pthread_mutex_lock(&bg->lock);
+	__atomic_store_n(&bg->request, bg->request + 1, __ATOMIC_RELAXED);
+	bg->reqw = texw;
+	bg->reqh = texh;
+	bg->reqbackend = bakebackend;
+	bg->reqmode = distancemode;
+	pthread_cond_signal(&bg->wake);
+	pthread_mutex_unlock(&bg->lock);
+}
+
+// returns the finished back buffer with the lock held, or NULL. A non NULL
+// result must be handed back with Background_Release once uploaded.
+static unsigned char *Background_Acquire(backgroundbake_t *bg, int *texw, int *texh)
+{
+	if (!bg->started)
+		return NULL;
+
+	pthread_mutex_lock(&bg->lock);
+	if (bg->ready < 0)
+	{
+		pthread_mutex_unlock(&bg->lock);
+		return NULL;
+	}
+
+	*texw = bg->readyw;
+	*texh = bg->readyh;
+	return bg->buffers[bg->ready];
+}
+
+static void Background_Release(backgroundbake_t *bg)
+{
+	bg->front = bg->ready;
+	bg->ready = -1;
+	pthread_mutex_unlock(&bg->lock);
+}
+
+static void Bake_CycleBackend()
+{
+	bakebackend = (bakebackend + 1) % NUM_BAKE_BACKENDS;
+	bakedirty = true;
+	printf("bake backend: %s\n", bakebackendnames[bakebackend]);
+}
+
+static void Bake_CycleMode()
+{
+	bakemode = (bakemode + 1) % NUM_BAKE_MODES;
+	bakedirty = true;
+	printf("bake mode: %s\n", bakemodenames[bakemode]);
 }
 
 static void DrawField()
 {
+	TRACE_ZONE("DrawField");
 	static int texw, texh;
 	static GLuint texture;
 
-	if (texw != renderwidth || texh != renderheight)
+	if (bakemode == bm_background)
+	{
+		if (texw != renderwidth || texh != renderheight || bakedirty)
+		{
+			bakedirty = false;
+			texw = renderwidth;
+			texh = renderheight;
+			Background_Request(&background, texw, texh);
+		}
+
+		// keep drawing the old texture, stretched, until the new one lands
+		int readyw, readyh;
+		unsigned char *data = Background_Acquire(&background, &readyw, &readyh);
+		if (data)
+		{
+			if (!texture)
+				glGenTextures(1, &texture);
+
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, readyw, readyh, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			Background_Release(&background);
+		}
+
+		if (!texture)
+			return;
+	}
+	else if (texw != renderwidth || texh != renderheight || bakedirty)
 	{
+		bakedirty = false;
 		texw = renderwidth;
 		texh = renderheight;
 
@@ -393,9 +814,35 @@ static void DrawField()
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texw, texh, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
 		glBindTexture(GL_TEXTURE_2D, texture);
-		unsigned char *data = BuildTextureData(texw, texh);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texw, texh, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		free(data);
+		perfsample_t sample;
+		if (bakemode == bm_progressive && bakebackend == bb_exact)
+		{
+			Stats_PhaseBegin(&sample);
+			Progressive_Begin(&progressive, texw, texh);
+			Stats_PhaseEnd(sp_bake, &sample);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texw, texh, GL_RGBA, GL_UNSIGNED_BYTE, progressive.data);
+		}
+		else
+		{
+			Stats_PhaseBegin(&sample);
+			unsigned char *data = BuildTextureData(Mem_Frame(), texw, texh);
+			Stats_PhaseEnd(sp_bake, &sample);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texw, texh, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			progressive.row = progressive.texh;
+		}
+	}
+	else if (progressive.row < progressive.texh)
+	{
+		perfsample_t sample;
+		int first, count;
+
+		Stats_PhaseBegin(&sample);
+		first = Progressive_Step(&progressive, bakebudget, &count);
+		Stats_PhaseEnd(sp_bake, &sample);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, texw, count, GL_RGBA, GL_UNSIGNED_BYTE, progressive.data + first * texw * 4);
+		if (progressive.row == progressive.texh)
+			printf("progressive bake complete\n");
 	}
 
 	glBindTexture(GL_TEXTURE_2D, texture);
@@ -432,8 +879,8 @@ static void DrawTriangles()
 	glColor3f(1, 1, 1);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(2, GL_FLOAT, 2 * sizeof(float), (void*)vertices);
-	glDrawArrays(GL_TRIANGLES, 0, 171);
+	glVertexPointer(2, GL_FLOAT, 2 * sizeof(float), (void*)mesh.verts);
+	glDrawElements(GL_TRIANGLES, mesh.numtris * 3, GL_UNSIGNED_INT, mesh.tris);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
@@ -461,6 +908,7 @@ static void DrawPlayer()
 
 static void Thing_Frame()
 {
+	TRACE_ZONE("Thing_Frame");
 	static float pos[2];
 	static bool spawned;
 
@@ -473,8 +921,7 @@ static void Thing_Frame()
 
 	// distance, normal and tangent
 	float d, n[2], t[2];
-	d = Distance(pos);
-	Gradient(n, pos);
+	d = Game_DistanceGradient(n, pos);
 	Vec2_Normalize(n);
 	t[0] = -n[1];
 	t[1] = n[0];
@@ -512,21 +959,23 @@ static void Draw()
 
 static void TryMove()
 {
+	TRACE_ZONE("TryMove");
 	float nextx, nexty;
 
 	// get the target location
 	nextx = objx + movex;
 	nexty = objy + movey;
 
-	for (int i = 0; i < 5; i++)
+	for (int i = 0; i < TRYMOVE_MAX_TRIES; i++)
 	{
 		// check for a collision
 		float p[2] = { nextx, nexty };
-		float d = Distance(p);
+		float d = Game_Distance(p);
 		if (d > 0.2f)
 		{
 			objx = nextx;
 			objy = nexty;
+			Stats_TryMove(i + 1, false);
 			return;
 		}
 
@@ -536,13 +985,16 @@ static void TryMove()
 			float vy = nexty - objy;
 			float dot = (vx * movex) + (vy * movey);
 			if(dot < 0.0f)
+			{
+				Stats_TryMove(i + 1, true);
 				return;
+			}
 		}
 
 		// project the move along the tangent	
 		//float n[2], t[2], pos[2] = { objx, objy };
 		float n[2], t[2], pos[2] = { 0.5 * (objx + nextx), 0.5f * (objy + nexty) };
-		Gradient(n, pos);
+		Game_DistanceGradient(n, pos);
 		Vec2_Normalize(n);
 		t[0] = -n[1];
 		t[1] = n[0];
@@ -553,11 +1005,13 @@ static void TryMove()
 		nexty = objy + t[1] * dot;
 	}
 
+	Stats_TryMove(0, false);
 	printf("no good move\n");
 }
 
 static void Player_Frame()
 {
+	TRACE_ZONE("Player_Frame");
 	float s = 0.1f;
 
 	movex = 0;
@@ -612,17 +1066,17 @@ static void Player_Frame()
 	}
 #endif
 
-	TryMove();
+	// standing still is not a move
+	if (movex != 0.0f || movey != 0.0f)
+		TryMove();
 
 	// position correction
 	{
 		float p[2] = { objx, objy };
-		float d = Distance(p);
+		float n[2];
+		float d = Game_DistanceGradient(n, p);
 		if (d < 0.0f)
 		{
-			float n[2];
-			Gradient(n, p);
-			Vec2_Normalize(n);
 			objx += d * 1.02f * n[0];
 			objy += d * 1.02f * n[1];
 		}
@@ -632,6 +1086,7 @@ static void Player_Frame()
 // glut functions
 static void DisplayFunc()
 {
+	TRACE_ZONE("DisplayFunc");
 	glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	//glEnable(GL_DEPTH_TEST);
@@ -683,6 +1138,18 @@ static void KeyDownFunc(unsigned char key, int x, int y)
 		keyactions[ka_x] = true;
 	if (key == 'z')
 		keyactions[ka_y] = true;
+	if (key == 'm')
+		Distance_CycleMode();
+	if (key == 'f')
+		Game_CycleQuery();
+	if (key == 't')
+		ADF_CycleTolerance();
+	if (key == 'b')
+		Bake_CycleBackend();
+	if (key == 'p')
+		Bake_CycleMode();
+	if (key == 'u')
+		Mem_PrintStats();
 }
 static void KeyUpFunc(unsigned char key, int x, int y)
 {
@@ -726,6 +1193,12 @@ static void SpecialUpFunc(int key, int x, int y)
 // split into Frame()
 static void TimerFunc(int value)
 {
+	TRACE_ZONE("TimerFunc");
+
+	// nothing from the last tick survives
+	Mem_ResetFrame();
+	Stats_Tick();
+
 	// standard mouse input
 	ProcessInput();
 
@@ -737,12 +1210,66 @@ static void TimerFunc(int value)
 }
 
 static void PrintUsage()
-{}
+{
+	printf("usage: sdfield6 [options]\n");
+	printf("  -mesh <file>    mesh file to load instead of the built in outline\n");
+	printf("  -gridres <n>    uniform grid cells along the longest mesh axis (default the mesh file's grid, else %i)\n", GRID_DEFAULT_RES);
+	printf("  -fieldres <n>   baked field samples per axis (default %i)\n", FIELD_DEFAULT_RES);
+	printf("  -adftol <t>     adaptive field tolerance (default %g)\n", ADF_DEFAULT_TOLERANCE);
+	printf("  -threads <n>    bake threads, 1 bakes serially (default one per core)\n");
+	printf("  -sync           bake the whole field on resize instead of progressively\n");
+	printf("  -background     bake on a background thread and swap when done\n");
+	printf("  -bakebudget <ms> progressive bake time per frame (default %g)\n", BAKE_DEFAULT_BUDGET);
+	printf("  -hugepages      back the memory arenas with transparent huge pages\n");
+	printf("  -trace <file>   write a chrome trace of the zones at exit, needs make TRACE=1\n");
+	printf("  -stats <file>   append a summary of the gameplay queries to the file every interval\n");
+	printf("  -statsinterval <s> seconds per stats summary (default %g)\n", STATS_DEFAULT_INTERVAL);
+}
 
 int main(int argc, char *argv[])
 {
 	glutInit(&argc, argv);
 
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-mesh") && i + 1 < argc)
+			meshname = argv[++i];
+		else if (!strcmp(argv[i], "-gridres") && i + 1 < argc)
+			gridres = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-fieldres") && i + 1 < argc)
+			fieldres = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-adftol") && i + 1 < argc)
+			adftolerance = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			numthreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-sync"))
+			bakemode = bm_sync;
+		else if (!strcmp(argv[i], "-background"))
+			bakemode = bm_background;
+		else if (!strcmp(argv[i], "-bakebudget") && i + 1 < argc)
+			bakebudget = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-hugepages"))
+			memhugepages = true;
+		else if (!strcmp(argv[i], "-trace") && i + 1 < argc)
+			tracename = argv[++i];
+		else if (!strcmp(argv[i], "-stats") && i + 1 < argc)
+			statsname = argv[++i];
+		else if (!strcmp(argv[i], "-statsinterval") && i + 1 < argc)
+			statsinterval = (float)atof(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// min and max evaluate their arguments twice so clamp after parsing
+	gridres = max(0, gridres);
+	fieldres = max(2, fieldres);
+	adftolerance = max(1e-5f, adftolerance);
+	bakebudget = max(0.1f, bakebudget);
+	statsinterval = max(0.1f, statsinterval);
+
 	glutInitWindowPosition(0, 0);
 	glutInitWindowSize(400, 400);
 	glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH | GLUT_DOUBLE);
@@ -759,6 +1286,28 @@ int main(int argc, char *argv[])
 	glutPassiveMotionFunc(MouseMoveFunc);
 	glutTimerFunc(16, TimerFunc, 0);
 
+	// started first so the workers are named
+	if (tracename)
+	{
+		Trace_Start(tracename);
+		atexit(Trace_Flush);
+	}
+	Threads_Init(numthreads);
+	atexit(Mem_PrintStats);
+	if (statsname)
+	{
+		Stats_Open();
+		atexit(Stats_Close);
+	}
+
+	if (meshname)
+		Mesh_Load(&mesh, meshname);
+	else
+		Mesh_Default(&mesh);
+	Distance_Init(&mesh, gridres);
+	Field_Build(&field, fieldres);
+	ADF_Build(&adf, adftolerance);
+
 	glutMainLoop();
 
 	return 0;
@@ -0,0 +1,471 @@
+// compares the triangle distance kernels from the earlier sdfield versions
+// on identical point sets. Each kernel is evaluated for every point against
+// every triangle of the mesh and timed, branch misses and instructions per
+// cycle are counted when the kernel allows perf events, and the results are
+// checked against the sdfield6 kernel.
+
+#include "sdf.h"
+
+#define KERNEL_POINTS		1024
+#define KERNEL_MISMATCH		1e-4f		// differences above this are counted
+#define MAX_KERNEL_REPS		1000
+
+enum kernelformat_t
+{
+	kf_json,
+	kf_csv,
+	NUM_KERNEL_FORMATS
+};
+
+static const char *kernelformatnames[NUM_KERNEL_FORMATS] = { "json", "csv" };
+
+static int warmup = 2;
+static int reps = 15;
+static int format = -1;			// -1 picks from the file extension
+static const char *meshname;		// NULL for the built in outline
+static const char *outname;
+
+// ==============================================
+// sdfield2
+//
+// classifies the point by the signs of the areas it makes with each edge.
+// Inside every edge or outside one gives the edge distance, outside two
+// gives the vertex distance. The original is inside #if 0 and does not
+// compile: the test point is overwritten with a debug value, the sign test
+// is written !signs[0] == 3, the inside case returns 0 and it prints the
+// region. Those are fixed here, the classification is as written. Being
+// outside one edge line does not rule out a vertex region so the result is
+// too small near the ends of an edge.
+
+static float Area_VertexDistance(float a[2], float b[2])
+{
+	float v[2] = { b[0] - a[0], b[1] - a[1] };
+	return Vec2_Length(v);
+}
+
+static float Area_EdgeDistance(float v0[2], float v1[2], float p[2])
+{
+	float e[2] = { v1[0] - v0[0], v1[1] - v0[1] };
+	Vec2_Normalize(e);
+	float n[2] = { e[1], -e[0] };
+
+	return (n[0] * p[0]) + (n[1] * p[1]) - (n[0] * v0[0]) - (n[1] * v0[1]);
+}
+
+static float Area_TriangleArea(float v0[2], float v1[2], float v2[2])
+{
+	float x0 = v0[0];
+	float y0 = v0[1];
+	float x1 = v1[0];
+	float y1 = v1[1];
+	float x2 = v2[0];
+	float y2 = v2[1];
+
+	return 0.5f * ((x0 * y1) - (x0 * y2) - (x1 * y0) + (x1 * y2 ) + (x2 * y0) - (x2 * y1));
+}
+
+static float Area_TriangleDistance(float p[2], float v0[2], float v1[2], float v2[2])
+{
+	float areas[3];
+	int positive;
+
+	areas[0] = -Area_TriangleArea(v0, v1, p);
+	areas[1] = -Area_TriangleArea(v1, v2, p);
+	areas[2] = -Area_TriangleArea(v2, v0, p);
+
+	positive = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		if (areas[i] > 0.0f)
+			positive++;
+	}
+
+	// inside, or closer to an edge
+	if (positive < 2)
+		return max(Area_EdgeDistance(v0, v1, p), max(Area_EdgeDistance(v1, v2, p), Area_EdgeDistance(v2, v0, p)));
+
+	// closer to a vertex
+	float d0 = Area_VertexDistance(v0, p);
+	float d1 = Area_VertexDistance(v1, p);
+	float d2 = Area_VertexDistance(v2, p);
+	return min(d0, min(d1, d2));
+}
+
+// ==============================================
+// sdfield3
+//
+// the planes and skewed normals of its single triangle are computed once
+// into statics. Here that is done for every triangle before timing starts
+// and the kernel reads them back.
+
+typedef struct statictri_s
+{
+	float v0[2], v1[2], v2[2];
+	float abc0[3], abc1[3], abc2[3];
+	float n00[2], n01[2], n10[2], n11[2], n20[2], n21[2];
+
+} statictri_t;
+
+static statictri_t *statictris;
+
+static void Static_Init(const mesh_t *m)
+{
+	statictris = (statictri_t*)Mem_Alloc(m->numtris * sizeof(statictri_t), mt_cooked);
+
+	for (int i = 0; i < m->numtris; i++)
+	{
+		statictri_t *t = statictris + i;
+
+		Vec2_Copy(t->v0, m->verts[m->tris[i][0]]);
+		Vec2_Copy(t->v1, m->verts[m->tris[i][1]]);
+		Vec2_Copy(t->v2, m->verts[m->tris[i][2]]);
+
+		Plane2d(t->abc0, t->v0, t->v1);
+		Plane2d(t->abc1, t->v1, t->v2);
+		Plane2d(t->abc2, t->v2, t->v0);
+
+		// calculate positive and negative skewed normals
+		t->n00[0] = -t->abc2[1], t->n00[1] =  t->abc2[0];
+		t->n01[0] =  t->abc0[1], t->n01[1] = -t->abc0[0];
+		t->n10[0] = -t->abc0[1], t->n10[1] =  t->abc0[0];
+		t->n11[0] =  t->abc1[1], t->n11[1] = -t->abc1[0];
+		t->n20[0] = -t->abc1[1], t->n20[1] =  t->abc1[0];
+		t->n21[0] =  t->abc2[1], t->n21[1] = -t->abc2[0];
+	}
+}
+
+static float Static_TriangleDistance(statictri_t *t, float p[2])
+{
+	float v0p[2], v1p[2], v2p[2];
+
+	v0p[0] = p[0] - t->v0[0], v0p[1] = p[1] - t->v0[1];
+	v1p[0] = p[0] - t->v1[0], v1p[1] = p[1] - t->v1[1];
+	v2p[0] = p[0] - t->v2[0], v2p[1] = p[1] - t->v2[1];
+
+	if (Vec2_Dot(t->n00, v0p) > 0.0f && Vec2_Dot(t->n01, v0p) > 0.0f)
+		return Vec2_Length(v0p);
+	if (Vec2_Dot(t->n10, v1p) > 0.0f && Vec2_Dot(t->n11, v1p) > 0.0f)
+		return Vec2_Length(v1p);
+	if (Vec2_Dot(t->n20, v2p) > 0.0f && Vec2_Dot(t->n21, v2p) > 0.0f)
+		return Vec2_Length(v2p);
+
+	float f0 = PlaneDistance(t->abc0, p);
+	float f1 = PlaneDistance(t->abc1, p);
+	float f2 = PlaneDistance(t->abc2, p);
+
+	return max(f0, max(f1, f2));
+}
+
+// ==============================================
+// kernels
+//
+// every kernel fills out[point * numtris + tri]. The loops are written out
+// for each kernel so the call is not behind a function pointer.
+
+typedef void (*kernelfunc_t)(float (*p)[2], int numpoints, float *out);
+
+static void Kernel_Area(float (*p)[2], int numpoints, float *out)
+{
+	for (int i = 0; i < numpoints; i++)
+	{
+		for (int j = 0; j < mesh.numtris; j++)
+			*out++ = Area_TriangleDistance(p[i], mesh.verts[mesh.tris[j][0]], mesh.verts[mesh.tris[j][1]], mesh.verts[mesh.tris[j][2]]);
+	}
+}
+
+static void Kernel_Static(float (*p)[2], int numpoints, float *out)
+{
+	for (int i = 0; i < numpoints; i++)
+	{
+		for (int j = 0; j < mesh.numtris; j++)
+			*out++ = Static_TriangleDistance(statictris + j, p[i]);
+	}
+}
+
+// sdfield4 and sdfield5 have the same kernel as distance.cpp
+static void Kernel_Skew(float (*p)[2], int numpoints, float *out)
+{
+	for (int i = 0; i < numpoints; i++)
+	{
+		for (int j = 0; j < mesh.numtris; j++)
+			*out++ = TriangleDistance(p[i], mesh.verts[mesh.tris[j][0]], mesh.verts[mesh.tris[j][1]], mesh.verts[mesh.tris[j][2]]);
+	}
+}
+
+static void Kernel_Cooked(float (*p)[2], int numpoints, float *out)
+{
+	for (int i = 0; i < numpoints; i++)
+	{
+		for (int j = 0; j < mesh.numtris; j++)
+			*out++ = CookedTriangleDistance(&cooked, j, p[i]);
+	}
+}
+
+typedef struct kernel_s
+{
+	const char *name;
+	const char *origin;
+	kernelfunc_t func;
+
+} kernel_t;
+
+// the first is the reference the others are checked against
+static kernel_t kernels[] =
+{
+	{ "skew", "sdfield4-6 TriangleDistance", Kernel_Skew },
+	{ "area", "sdfield2 signed areas", Kernel_Area },
+	{ "static", "sdfield3 precomputed planes", Kernel_Static },
+	{ "cooked", "sdfield6 cooked triangles", Kernel_Cooked },
+};
+
+#define NUM_KERNELS	(int)(sizeof(kernels) / sizeof(kernels[0]))
+
+// ==============================================
+// point sets
+
+static unsigned int kernelseed = 0x5df5eed;
+
+static float Kernel_Random()
+{
+	// xorshift32
+	kernelseed ^= kernelseed << 13;
+	kernelseed ^= kernelseed >> 17;
+	kernelseed ^= kernelseed << 5;
+
+	return (kernelseed >> 8) * (1.0f / (1 << 24));
+}
+
+enum pointset_t
+{
+	ps_uniform,
+	ps_vertices,
+	NUM_POINT_SETS
+};
+
+static const char *pointsetnames[NUM_POINT_SETS] = { "uniform", "vertices" };
+
+// uniform covers the mesh bounds with a margin, vertices is scattered
+// closely around the mesh vertices where the kernels branch the most
+static void Kernel_Points(float (*p)[2], int numpoints, int set)
+{
+	float size = max(mesh.maxs[0] - mesh.mins[0], mesh.maxs[1] - mesh.mins[1]);
+
+	for (int i = 0; i < numpoints; i++)
+	{
+		if (set == ps_uniform)
+		{
+			p[i][0] = mesh.mins[0] - 0.25f * size + 1.5f * size * Kernel_Random();
+			p[i][1] = mesh.mins[1] - 0.25f * size + 1.5f * size * Kernel_Random();
+		}
+		else
+		{
+			float *v = mesh.verts[(int)(Kernel_Random() * mesh.numverts) % mesh.numverts];
+
+			p[i][0] = v[0] + 0.02f * size * (Kernel_Random() - 0.5f);
+			p[i][1] = v[1] + 0.02f * size * (Kernel_Random() - 0.5f);
+		}
+	}
+}
+
+// ==============================================
+// harness
+
+typedef struct kernelresult_s
+{
+	const char *pointset;
+	const kernel_t *kernel;
+	long long evals;			// point triangle pairs per repetition
+	int reps;
+	double min, p50;			// nanoseconds per evaluation
+	double branchmisses;			// per evaluation, -1 when not counted
+	double ipc;				// -1 when not counted
+	float maxdiff;				// against the reference kernel
+	long long mismatches;
+
+} kernelresult_t;
+
+static kernelresult_t results[NUM_POINT_SETS * NUM_KERNELS];
+static int numresults;
+
+static int Kernel_CompareDouble(const void *a, const void *b)
+{
+	double da = *(const double*)a, db = *(const double*)b;
+
+	return (da > db) - (da < db);
+}
+
+static void Kernel_Run(int set, const kernel_t *k, float (*p)[2], int numpoints, float *out, const float *ref)
+{
+	static double times[MAX_KERNEL_REPS];
+	kernelresult_t *r = results + numresults++;
+	long long evals = (long long)numpoints * mesh.numtris;
+	perfphase_t counted;
+	perfsample_t sample;
+
+	for (int i = 0; i < warmup; i++)
+		k->func(p, numpoints, out);
+
+	// counters from a run of their own so reading them is not in the timing
+	Perf_Reset(&counted);
+	Perf_Begin(&sample);
+	k->func(p, numpoints, out);
+	Perf_End(&counted, &sample);
+
+	for (int i = 0; i < reps; i++)
+	{
+		double t0 = Sys_Time();
+		k->func(p, numpoints, out);
+		times[i] = (Sys_Time() - t0) * 1e9 / evals;
+	}
+	qsort(times, reps, sizeof(double), Kernel_CompareDouble);
+
+	r->pointset = pointsetnames[set];
+	r->kernel = k;
+	r->evals = evals;
+	r->reps = reps;
+	r->min = times[0];
+	r->p50 = times[reps / 2];
+	r->branchmisses = counted.counts[pc_branchmisses] < 0 ? -1.0 : (double)counted.counts[pc_branchmisses] / evals;
+	r->ipc = Perf_IPC(&counted);
+	r->maxdiff = 0.0f;
+	r->mismatches = 0;
+	for (long long i = 0; ref && i < evals; i++)
+	{
+		float diff = fabsf(out[i] - ref[i]);
+
+		r->maxdiff = max(r->maxdiff, diff);
+		if (diff > KERNEL_MISMATCH)
+			r->mismatches++;
+	}
+
+	printf("%-8s %-7s %10.2f ns  %8.1f Mevals/s  %7.4f misses  %5.2f ipc  max diff %-10g %lli mismatches  (%s)\n",
+		r->pointset, k->name, r->p50, 1e3 / r->p50, r->branchmisses, r->ipc, r->maxdiff, r->mismatches, k->origin);
+}
+
+// ==============================================
+// output
+
+static void WriteJSON(FILE *fp)
+{
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"triangles\": %i,\n", mesh.numtris);
+	fprintf(fp, "\t\"reference\": \"%s\",\n", kernels[0].name);
+	fprintf(fp, "\t\"kernels\": [\n");
+	for (int i = 0; i < numresults; i++)
+	{
+		kernelresult_t *r = results + i;
+
+		fprintf(fp, "\t\t{ \"pointset\": \"%s\", \"kernel\": \"%s\", \"origin\": \"%s\", \"evals\": %lli, \"reps\": %i, \"min\": %.3f, \"p50\": %.3f, \"branchmisses\": %.4f, \"ipc\": %.3f, \"maxdiff\": %g, \"mismatches\": %lli }%s\n",
+			r->pointset, r->kernel->name, r->kernel->origin, r->evals, r->reps, r->min, r->p50, r->branchmisses, r->ipc, r->maxdiff, r->mismatches,
+			i + 1 < numresults ? "," : "");
+	}
+	fprintf(fp, "\t]\n");
+	fprintf(fp, "}\n");
+}
+
+static void WriteCSV(FILE *fp)
+{
+	fprintf(fp, "pointset,kernel,evals,reps,min_ns,p50_ns,branchmisses,ipc,maxdiff,mismatches\n");
+	for (int i = 0; i < numresults; i++)
+	{
+		kernelresult_t *r = results + i;
+
+		fprintf(fp, "%s,%s,%lli,%i,%.3f,%.3f,%.4f,%.3f,%g,%lli\n", r->pointset, r->kernel->name, r->evals, r->reps,
+			r->min, r->p50, r->branchmisses, r->ipc, r->maxdiff, r->mismatches);
+	}
+}
+
+static void PrintUsage()
+{
+	printf("usage: sdfkernels [options] [output]\n");
+	printf("  -mesh <file>           mesh file to use instead of the built in outline\n");
+	printf("  -warmup <n>            untimed runs before timing (default %i)\n", warmup);
+	printf("  -reps <n>              timed repetitions (default %i)\n", reps);
+	printf("  -format <json|csv>     output format (default from the extension, else json)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-mesh") && i + 1 < argc)
+			meshname = argv[++i];
+		else if (!strcmp(argv[i], "-warmup") && i + 1 < argc)
+			warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-reps") && i + 1 < argc)
+			reps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-format") && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+
+			for (format = 0; format < NUM_KERNEL_FORMATS; format++)
+			{
+				if (!strcmp(name, kernelformatnames[format]))
+					break;
+			}
+			if (format == NUM_KERNEL_FORMATS)
+				Error("unknown format \"%s\"\n", name);
+		}
+		else if (argv[i][0] != '-' && !outname)
+			outname = argv[i];
+		else
+		{
+			PrintUsage();
+			return (strcmp(argv[i], "-help") ? 1 : 0);
+		}
+	}
+
+	// min and max evaluate their arguments twice so clamp after parsing
+	warmup = max(0, warmup);
+	reps = max(1, min(reps, MAX_KERNEL_REPS));
+
+	if (format < 0)
+	{
+		const char *ext = outname ? strrchr(outname, '.') : NULL;
+
+		format = (ext && !strcmp(ext, ".csv")) ? kf_csv : kf_json;
+	}
+
+	if (meshname)
+		Mesh_Load(&mesh, meshname);
+	else
+		Mesh_Default(&mesh);
+	if (!cooked.numpadded)
+		Cook_Triangles(&cooked, &mesh);
+	Static_Init(&mesh);
+	Perf_Init();
+
+	// the points are cut down on large meshes to keep a repetition short
+	int numpoints = max(16, min(KERNEL_POINTS, (1 << 20) / mesh.numtris));
+	arena_t *temp = Mem_Temp();
+	float (*p)[2] = (float(*)[2])Arena_Alloc(temp, numpoints * sizeof(*p), MEM_ALIGN);
+	float *ref = (float*)Arena_Alloc(temp, (size_t)numpoints * mesh.numtris * sizeof(float), MEM_ALIGN);
+	float *out = (float*)Arena_Alloc(temp, (size_t)numpoints * mesh.numtris * sizeof(float), MEM_ALIGN);
+
+	printf("%i triangles, %i points, %i reps\n", mesh.numtris, numpoints, reps);
+	for (int set = 0; set < NUM_POINT_SETS; set++)
+	{
+		Kernel_Points(p, numpoints, set);
+		Kernel_Run(set, &kernels[0], p, numpoints, ref, NULL);
+		for (int i = 1; i < NUM_KERNELS; i++)
+			Kernel_Run(set, &kernels[i], p, numpoints, out, ref);
+	}
+
+	if (outname)
+	{
+		FILE *fp = fopen(outname, "w");
+		if (!fp)
+			Error("unable to open \"%s\" for writing\n", outname);
+
+		if (format == kf_csv)
+			WriteCSV(fp);
+		else
+			WriteJSON(fp);
+
+		if (ferror(fp) | fclose(fp))
+			Error("write to \"%s\" failed\n", outname);
+		printf("%i results written to %s as %s\n", numresults, outname, kernelformatnames[format]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "sdf.h"
+
+// ==============================================
+// thread pool
+//
+// a fixed set of workers that run numbered jobs. Each run hands every
+// worker a contiguous range of job numbers; a worker takes jobs from the
+// front of its own range and when that is empty steals from the back of
+// another worker's range. The calling thread works as worker 0 and
+// Threads_Run returns once every job has finished.
+
+threadpool_t pool;
+
+static bool Threads_TakeJob(int thread, int *job)
+{
+	workrange_t *r = pool.ranges + thread;
+
+	pthread_mutex_lock(&r->lock);
+	if (r->head < r->tail)
+	{
+		*job = r->head++;
+		pthread_mutex_unlock(&r->lock);
+		return true;
+	}
+	pthread_mutex_unlock(&r->lock);
+
+	for (int i = 1; i < pool.numthreads; i++)
+	{
+		r = pool.ranges + (thread + i) % pool.numthreads;
+
+		pthread_mutex_lock(&r->lock);
+		if (r->head < r->tail)
+		{
+			*job = --r->tail;
+			pthread_mutex_unlock(&r->lock);
+			return true;
+		}
+		pthread_mutex_unlock(&r->lock);
+	}
+
+	return false;
+}
+
+static void Threads_Work(int thread)
+{
+	TRACE_ZONE("Threads_Work");
+	long long counts[NUM_PERF_COUNTERS];
+	int job;
+
+	// the caller's own counters already cover worker 0
+	if (perfenabled && thread)
+		Perf_Read(counts);
+
+	while (Threads_TakeJob(thread, &job))
+		pool.func(job, thread, pool.data);
+
+	if (perfenabled && thread)
+		Perf_AddWorker(counts);
+}
+
+static void *Threads_Main(void *arg)
+{
+	int thread = (int)(intptr_t)arg;
+	int generation = 0;
+	char name[32];
+
+	snprintf(name, sizeof(name), "worker %i", thread);
+	Trace_ThreadName(name);
+	while (1)
+	{
+		pthread_mutex_lock(&pool.lock);
+		while (pool.generation == generation)
+			pthread_cond_wait(&pool.wake, &pool.lock);
+		generation = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+
+		Threads_Work(thread);
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.running == 0)
+			pthread_cond_signal(&pool.done);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	return NULL;
+}
+
+void Threads_Init(int count)
+{
+	if (count <= 0)
+		count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	pool.numthreads = min(max(count, 1), MAX_THREADS);
+
+	pthread_mutex_init(&pool.runlock, NULL);
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.wake, NULL);
+	pthread_cond_init(&pool.done, NULL);
+	for (int i = 0; i < pool.numthreads; i++)
+		pthread_mutex_init(&pool.ranges[i].lock, NULL);
+
+	for (int i = 1; i < pool.numthreads; i++)
+	{
+		if (pthread_create(&pool.threads[i], NULL, Threads_Main, (void*)(intptr_t)i))
+			Error("Threads: unable to create worker %i\n", i);
+	}
+
+	printf("thread pool: %i threads\n", pool.numthreads);
+}
+
+// may be called from any thread, concurrent runs are serialized
+void Threads_Run(int numjobs, jobfunc_t func, void *data)
+{
+	TRACE_ZONE("Threads_Run");
+	pthread_mutex_lock(&pool.runlock);
+
+	pool.func = func;
+	pool.data = data;
+	for (int i = 0; i < pool.numthreads; i++)
+	{
+		pool.ranges[i].head = (int)((long long)numjobs * i / pool.numthreads);
+		pool.ranges[i].tail = (int)((long long)numjobs * (i + 1) / pool.numthreads);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.running = pool.numthreads - 1;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+
+	Threads_Work(0);
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.running)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+
+	pthread_mutex_unlock(&pool.runlock);
+}
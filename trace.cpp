@@ -0,0 +1,185 @@
+#include "sdf.h"
+
+// ==============================================
+// trace zones
+//
+// TRACE_ZONE marks a scope to be timed when built with TRACE defined. Each
+// thread appends finished zones to its own buffer, so recording takes no
+// locks: a buffer is only written by its thread and the event count is
+// published after each event for Trace_Write to read. The buffers are
+// arenas, committed as they fill. Trace_Write saves everything as a chrome
+// trace that chrome://tracing and Perfetto load.
+
+#define MAX_TRACE_THREADS	(MAX_THREADS + 8)
+#define TRACE_MAX_DEPTH		64
+#define TRACE_RESERVE		(1ull << 30)		// events per thread, about 40 million
+
+typedef struct traceevent_s
+{
+	const char *name;
+	uint64_t start;			// nanoseconds since Trace_Start
+	uint64_t duration;
+
+} traceevent_t;
+
+typedef struct tracethread_s
+{
+	char name[32];
+	arena_t events;
+	int numevents;			// published with release ordering
+	int dropped;			// events past the end of the reserve
+
+	// zones open on this thread
+	int depth;
+	const char *stackname[TRACE_MAX_DEPTH];
+	uint64_t stackstart[TRACE_MAX_DEPTH];
+
+} tracethread_t;
+
+static bool tracing;
+static const char *tracefilename;
+static uint64_t tracestart;
+
+static tracethread_t tracethreads[MAX_TRACE_THREADS];
+static int numtracethreads;
+static __thread tracethread_t *tracethread;
+
+static uint64_t Trace_Now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// the calling thread's buffer, registered on first use. NULL once every
+// slot is taken.
+static tracethread_t *Trace_Thread()
+{
+	if (!tracethread)
+	{
+		int index = __atomic_fetch_add(&numtracethreads, 1, __ATOMIC_ACQ_REL);
+
+		if (index >= MAX_TRACE_THREADS)
+			return NULL;
+
+		tracethread = tracethreads + index;
+		snprintf(tracethread->name, sizeof(tracethread->name), "thread %i", index);
+		Arena_Reserve(&tracethread->events, "trace", TRACE_RESERVE, false);
+	}
+
+	return tracethread;
+}
+
+// filename is written by Trace_Flush. Zones are only recorded between here
+// and the end of the program, so call it before starting any threads.
+void Trace_Start(const char *filename)
+{
+#ifndef TRACE
+	Warning("Trace: built without TRACE, only thread names will be recorded\n");
+#endif
+
+	tracefilename = filename;
+	tracestart = Trace_Now();
+	tracing = true;
+	Trace_ThreadName("main");
+}
+
+void Trace_ThreadName(const char *name)
+{
+	tracethread_t *t;
+
+	if (!tracing || !(t = Trace_Thread()))
+		return;
+
+	snprintf(t->name, sizeof(t->name), "%s", name);
+}
+
+void Trace_Begin(const char *name)
+{
+	tracethread_t *t;
+
+	if (!tracing || !(t = Trace_Thread()))
+		return;
+
+	if (t->depth < TRACE_MAX_DEPTH)
+	{
+		t->stackname[t->depth] = name;
+		t->stackstart[t->depth] = Trace_Now() - tracestart;
+	}
+	t->depth++;
+}
+
+void Trace_End()
+{
+	tracethread_t *t;
+	uint64_t end;
+
+	if (!tracing || !(t = Trace_Thread()))
+		return;
+
+	end = Trace_Now() - tracestart;
+	if (--t->depth >= TRACE_MAX_DEPTH)
+		return;
+
+	if (t->events.used + sizeof(traceevent_t) > t->events.size)
+	{
+		t->dropped++;
+		return;
+	}
+
+	traceevent_t *e = (traceevent_t*)Arena_Alloc(&t->events, sizeof(traceevent_t), 8);
+	e->name = t->stackname[t->depth];
+	e->start = t->stackstart[t->depth];
+	e->duration = end - e->start;
+	__atomic_store_n(&t->numevents, t->numevents + 1, __ATOMIC_RELEASE);
+}
+
+// may be called while other threads are still recording, their events
+// after this point are left out
+void Trace_Write(const char *filename)
+{
+	int numthreads = min(__atomic_load_n(&numtracethreads, __ATOMIC_ACQUIRE), MAX_TRACE_THREADS);
+	int total = 0, dropped = 0;
+	bool first = true;
+	FILE *fp;
+
+	fp = fopen(filename, "w");
+	if (!fp)
+	{
+		Warning("Trace: unable to open \"%s\" for writing\n", filename);
+		return;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (int i = 0; i < numthreads; i++)
+	{
+		tracethread_t *t = tracethreads + i;
+		int count = __atomic_load_n(&t->numevents, __ATOMIC_ACQUIRE);
+		const traceevent_t *e = (const traceevent_t*)t->events.base;
+
+		fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", i + 1, t->name);
+		first = false;
+		for (int j = 0; j < count; j++, e++)
+		{
+			fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}",
+				e->name, i + 1, e->start * 1e-3, e->duration * 1e-3);
+		}
+
+		total += count;
+		dropped += t->dropped;
+	}
+	fprintf(fp, "\n]}\n");
+
+	if (ferror(fp) | fclose(fp))
+		Warning("Trace: write to \"%s\" failed\n", filename);
+	else
+		printf("trace: %i events from %i threads written to %s, %i dropped\n", total, numthreads, filename, dropped);
+}
+
+// for atexit
+void Trace_Flush()
+{
+	if (tracing && tracefilename)
+		Trace_Write(tracefilename);
+}